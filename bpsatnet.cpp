@@ -0,0 +1,555 @@
+//
+// B+-tree alternative to the AVL based SatNet.
+//
+
+#include "bpsatnet.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BPT_MIN_LEAF (BPT_LEAF_KEYS / 2)
+#define BPT_MIN_INNER (BPT_INNER_KEYS / 2)
+
+BPSatNet::BPSatNet(){
+    m_root = nullptr;
+    m_head = nullptr;
+}
+
+BPSatNet::~BPSatNet(){
+    clear();
+}
+
+unsigned char BPSatNet::packAttrs(ALT alt, INCLIN inclin, STATE state){
+    return (unsigned char)(alt | (inclin << 2) | (state << 4));
+}
+
+Sat BPSatNet::unpack(int id, unsigned char attrs){
+    return Sat(id, static_cast<ALT>(attrs & 3), static_cast<INCLIN>((attrs >> 2) & 3),
+               static_cast<STATE>((attrs >> 4) & 3));
+}
+
+// number of keys strictly less than id, the slot where id belongs in a leaf
+int BPSatNet::countLess(const int* keys, int capacity, int count, int id){
+    int pos = 0;
+#ifdef __SSE2__
+    __m128i target = _mm_set1_epi32(id);
+    for (int i = 0; i < capacity; i += 4) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        __m128i less = _mm_cmplt_epi32(block, target);
+        pos += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+    }
+#else
+    for (int i = 0; i < capacity; i++) {
+        pos += (keys[i] < id);
+    }
+#endif
+    return (pos < count) ? pos : count;
+}
+
+// number of keys less than or equal to id, the child to descend into
+int BPSatNet::countLessEq(const int* keys, int capacity, int count, int id){
+    int pos = 0;
+#ifdef __SSE2__
+    __m128i target = _mm_set1_epi32(id);
+    for (int i = 0; i < capacity; i += 4) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        __m128i greater = _mm_cmpgt_epi32(block, target);
+        pos += 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(greater)));
+    }
+#else
+    for (int i = 0; i < capacity; i++) {
+        pos += (keys[i] <= id);
+    }
+#endif
+    return (pos < count) ? pos : count;
+}
+
+BPLeaf* BPSatNet::findLeaf(int id) const {
+    BPNode* node = m_root;
+    if (node == nullptr) {
+        return nullptr;
+    }
+    while (!node->isLeaf()) {
+        BPInternal* inner = static_cast<BPInternal*>(node);
+        node = inner->m_children[countLessEq(inner->m_keys, BPT_INNER_KEYS, inner->m_count, id)];
+    }
+    return static_cast<BPLeaf*>(node);
+}
+
+bool BPSatNet::findSatellite(int id) const {
+    BPLeaf* leaf = findLeaf(id);
+    if (leaf == nullptr) {
+        return false;
+    }
+    int pos = countLess(leaf->m_keys, BPT_LEAF_KEYS, leaf->m_count, id);
+    return pos < leaf->m_count && leaf->m_keys[pos] == id;
+}
+
+bool BPSatNet::setState(int id, STATE state){
+    BPLeaf* leaf = findLeaf(id);
+    if (leaf == nullptr) {
+        return false;
+    }
+    int pos = countLess(leaf->m_keys, BPT_LEAF_KEYS, leaf->m_count, id);
+    if (pos >= leaf->m_count || leaf->m_keys[pos] != id) {
+        return false;
+    }
+    leaf->m_attrs[pos] = (unsigned char)((leaf->m_attrs[pos] & 0x0F) | (state << 4));
+    return true;
+}
+
+bool BPSatNet::insertHelper(BPNode* node, int id, unsigned char attrs, int& upKey, BPNode*& upNode){
+    upNode = nullptr;
+    if (node->isLeaf()) {
+        BPLeaf* leaf = static_cast<BPLeaf*>(node);
+        int pos = countLess(leaf->m_keys, BPT_LEAF_KEYS, leaf->m_count, id);
+        if (pos < leaf->m_count && leaf->m_keys[pos] == id) {
+            return false; // duplicate ID, nothing to do
+        }
+        if (leaf->m_count < BPT_LEAF_KEYS) {
+            for (int i = leaf->m_count; i > pos; i--) {
+                leaf->m_keys[i] = leaf->m_keys[i - 1];
+                leaf->m_attrs[i] = leaf->m_attrs[i - 1];
+            }
+            leaf->m_keys[pos] = id;
+            leaf->m_attrs[pos] = attrs;
+            leaf->m_count++;
+            return true;
+        }
+
+        // leaf is full, split it in two halves
+        int keys[BPT_LEAF_KEYS + 1];
+        unsigned char vals[BPT_LEAF_KEYS + 1];
+        for (int i = 0, j = 0; i <= BPT_LEAF_KEYS; i++) {
+            if (i == pos) {
+                keys[i] = id;
+                vals[i] = attrs;
+            } else {
+                keys[i] = leaf->m_keys[j];
+                vals[i] = leaf->m_attrs[j];
+                j++;
+            }
+        }
+        BPLeaf* right = new BPLeaf();
+        int leftCount = (BPT_LEAF_KEYS + 1) / 2;
+        for (int i = 0; i < BPT_LEAF_KEYS; i++) {
+            leaf->m_keys[i] = (i < leftCount) ? keys[i] : BPT_EMPTY_KEY;
+            leaf->m_attrs[i] = (i < leftCount) ? vals[i] : 0;
+        }
+        for (int i = leftCount; i <= BPT_LEAF_KEYS; i++) {
+            right->m_keys[i - leftCount] = keys[i];
+            right->m_attrs[i - leftCount] = vals[i];
+        }
+        leaf->m_count = leftCount;
+        right->m_count = BPT_LEAF_KEYS + 1 - leftCount;
+        right->m_next = leaf->m_next;
+        leaf->m_next = right;
+        upKey = right->m_keys[0];
+        upNode = right;
+        return true;
+    }
+
+    BPInternal* inner = static_cast<BPInternal*>(node);
+    int idx = countLessEq(inner->m_keys, BPT_INNER_KEYS, inner->m_count, id);
+    int childKey = 0;
+    BPNode* childNode = nullptr;
+    if (!insertHelper(inner->m_children[idx], id, attrs, childKey, childNode)) {
+        return false;
+    }
+    if (childNode == nullptr) {
+        return true;
+    }
+
+    if (inner->m_count < BPT_INNER_KEYS) {
+        for (int i = inner->m_count; i > idx; i--) {
+            inner->m_keys[i] = inner->m_keys[i - 1];
+            inner->m_children[i + 1] = inner->m_children[i];
+        }
+        inner->m_keys[idx] = childKey;
+        inner->m_children[idx + 1] = childNode;
+        inner->m_count++;
+        return true;
+    }
+
+    // internal node is full, split it and push the middle key up
+    int keys[BPT_INNER_KEYS + 1];
+    BPNode* children[BPT_INNER_KEYS + 2];
+    children[0] = inner->m_children[0];
+    for (int i = 0, j = 0; i <= BPT_INNER_KEYS; i++) {
+        if (i == idx) {
+            keys[i] = childKey;
+            children[i + 1] = childNode;
+        } else {
+            keys[i] = inner->m_keys[j];
+            children[i + 1] = inner->m_children[j + 1];
+            j++;
+        }
+    }
+    int mid = (BPT_INNER_KEYS + 1) / 2;
+    BPInternal* right = new BPInternal();
+    for (int i = 0; i < BPT_INNER_KEYS; i++) {
+        inner->m_keys[i] = (i < mid) ? keys[i] : BPT_EMPTY_KEY;
+        inner->m_children[i + 1] = (i < mid) ? children[i + 1] : nullptr;
+    }
+    for (int i = mid + 1; i <= BPT_INNER_KEYS; i++) {
+        right->m_keys[i - mid - 1] = keys[i];
+    }
+    for (int i = mid + 1; i <= BPT_INNER_KEYS + 1; i++) {
+        right->m_children[i - mid - 1] = children[i];
+    }
+    inner->m_count = mid;
+    right->m_count = BPT_INNER_KEYS - mid;
+    upKey = keys[mid];
+    upNode = right;
+    return true;
+}
+
+void BPSatNet::insert(const Sat& satellite){
+    unsigned char attrs = packAttrs(satellite.getAlt(), satellite.getInclin(), satellite.getState());
+    if (m_root == nullptr) {
+        BPLeaf* leaf = new BPLeaf();
+        leaf->m_keys[0] = satellite.getID();
+        leaf->m_attrs[0] = attrs;
+        leaf->m_count = 1;
+        m_root = leaf;
+        m_head = leaf;
+        return;
+    }
+    int upKey = 0;
+    BPNode* upNode = nullptr;
+    insertHelper(m_root, satellite.getID(), attrs, upKey, upNode);
+    if (upNode != nullptr) {
+        // the root was split, grow the tree by one level
+        BPInternal* root = new BPInternal();
+        root->m_keys[0] = upKey;
+        root->m_children[0] = m_root;
+        root->m_children[1] = upNode;
+        root->m_count = 1;
+        m_root = root;
+    }
+}
+
+// fixes an underfull child by borrowing from or merging with a sibling
+void BPSatNet::rebalanceChild(BPInternal* parent, int idx){
+    BPNode* child = parent->m_children[idx];
+    BPNode* left = (idx > 0) ? parent->m_children[idx - 1] : nullptr;
+    BPNode* right = (idx < parent->m_count) ? parent->m_children[idx + 1] : nullptr;
+
+    if (child->isLeaf()) {
+        BPLeaf* leaf = static_cast<BPLeaf*>(child);
+        BPLeaf* leftLeaf = static_cast<BPLeaf*>(left);
+        BPLeaf* rightLeaf = static_cast<BPLeaf*>(right);
+        if (leftLeaf != nullptr && leftLeaf->m_count > BPT_MIN_LEAF) {
+            // borrow the largest key of the left sibling
+            for (int i = leaf->m_count; i > 0; i--) {
+                leaf->m_keys[i] = leaf->m_keys[i - 1];
+                leaf->m_attrs[i] = leaf->m_attrs[i - 1];
+            }
+            leftLeaf->m_count--;
+            leaf->m_keys[0] = leftLeaf->m_keys[leftLeaf->m_count];
+            leaf->m_attrs[0] = leftLeaf->m_attrs[leftLeaf->m_count];
+            leftLeaf->m_keys[leftLeaf->m_count] = BPT_EMPTY_KEY;
+            leaf->m_count++;
+            parent->m_keys[idx - 1] = leaf->m_keys[0];
+            return;
+        }
+        if (rightLeaf != nullptr && rightLeaf->m_count > BPT_MIN_LEAF) {
+            // borrow the smallest key of the right sibling
+            leaf->m_keys[leaf->m_count] = rightLeaf->m_keys[0];
+            leaf->m_attrs[leaf->m_count] = rightLeaf->m_attrs[0];
+            leaf->m_count++;
+            for (int i = 1; i < rightLeaf->m_count; i++) {
+                rightLeaf->m_keys[i - 1] = rightLeaf->m_keys[i];
+                rightLeaf->m_attrs[i - 1] = rightLeaf->m_attrs[i];
+            }
+            rightLeaf->m_count--;
+            rightLeaf->m_keys[rightLeaf->m_count] = BPT_EMPTY_KEY;
+            parent->m_keys[idx] = rightLeaf->m_keys[0];
+            return;
+        }
+        // merge the right one of the pair into the left one
+        int sep = (leftLeaf != nullptr) ? idx - 1 : idx;
+        BPLeaf* dst = static_cast<BPLeaf*>(parent->m_children[sep]);
+        BPLeaf* src = static_cast<BPLeaf*>(parent->m_children[sep + 1]);
+        for (int i = 0; i < src->m_count; i++) {
+            dst->m_keys[dst->m_count + i] = src->m_keys[i];
+            dst->m_attrs[dst->m_count + i] = src->m_attrs[i];
+        }
+        dst->m_count += src->m_count;
+        dst->m_next = src->m_next;
+        delete src;
+        for (int i = sep; i < parent->m_count - 1; i++) {
+            parent->m_keys[i] = parent->m_keys[i + 1];
+            parent->m_children[i + 1] = parent->m_children[i + 2];
+        }
+        parent->m_count--;
+        parent->m_keys[parent->m_count] = BPT_EMPTY_KEY;
+        parent->m_children[parent->m_count + 1] = nullptr;
+        return;
+    }
+
+    BPInternal* inner = static_cast<BPInternal*>(child);
+    BPInternal* leftInner = static_cast<BPInternal*>(left);
+    BPInternal* rightInner = static_cast<BPInternal*>(right);
+    if (leftInner != nullptr && leftInner->m_count > BPT_MIN_INNER) {
+        // rotate the separator down and the last key of the left sibling up
+        for (int i = inner->m_count; i > 0; i--) {
+            inner->m_keys[i] = inner->m_keys[i - 1];
+        }
+        for (int i = inner->m_count + 1; i > 0; i--) {
+            inner->m_children[i] = inner->m_children[i - 1];
+        }
+        inner->m_keys[0] = parent->m_keys[idx - 1];
+        inner->m_children[0] = leftInner->m_children[leftInner->m_count];
+        inner->m_count++;
+        parent->m_keys[idx - 1] = leftInner->m_keys[leftInner->m_count - 1];
+        leftInner->m_keys[leftInner->m_count - 1] = BPT_EMPTY_KEY;
+        leftInner->m_children[leftInner->m_count] = nullptr;
+        leftInner->m_count--;
+        return;
+    }
+    if (rightInner != nullptr && rightInner->m_count > BPT_MIN_INNER) {
+        // rotate the separator down and the first key of the right sibling up
+        inner->m_keys[inner->m_count] = parent->m_keys[idx];
+        inner->m_children[inner->m_count + 1] = rightInner->m_children[0];
+        inner->m_count++;
+        parent->m_keys[idx] = rightInner->m_keys[0];
+        for (int i = 1; i < rightInner->m_count; i++) {
+            rightInner->m_keys[i - 1] = rightInner->m_keys[i];
+        }
+        for (int i = 1; i <= rightInner->m_count; i++) {
+            rightInner->m_children[i - 1] = rightInner->m_children[i];
+        }
+        rightInner->m_count--;
+        rightInner->m_keys[rightInner->m_count] = BPT_EMPTY_KEY;
+        rightInner->m_children[rightInner->m_count + 1] = nullptr;
+        return;
+    }
+    // merge the pair around the separator into the left one
+    int sep = (leftInner != nullptr) ? idx - 1 : idx;
+    BPInternal* dst = static_cast<BPInternal*>(parent->m_children[sep]);
+    BPInternal* src = static_cast<BPInternal*>(parent->m_children[sep + 1]);
+    dst->m_keys[dst->m_count] = parent->m_keys[sep];
+    for (int i = 0; i < src->m_count; i++) {
+        dst->m_keys[dst->m_count + 1 + i] = src->m_keys[i];
+    }
+    for (int i = 0; i <= src->m_count; i++) {
+        dst->m_children[dst->m_count + 1 + i] = src->m_children[i];
+    }
+    dst->m_count += src->m_count + 1;
+    delete src;
+    for (int i = sep; i < parent->m_count - 1; i++) {
+        parent->m_keys[i] = parent->m_keys[i + 1];
+        parent->m_children[i + 1] = parent->m_children[i + 2];
+    }
+    parent->m_count--;
+    parent->m_keys[parent->m_count] = BPT_EMPTY_KEY;
+    parent->m_children[parent->m_count + 1] = nullptr;
+}
+
+bool BPSatNet::removeHelper(BPNode* node, int id){
+    if (node->isLeaf()) {
+        BPLeaf* leaf = static_cast<BPLeaf*>(node);
+        int pos = countLess(leaf->m_keys, BPT_LEAF_KEYS, leaf->m_count, id);
+        if (pos >= leaf->m_count || leaf->m_keys[pos] != id) {
+            return false;
+        }
+        for (int i = pos; i < leaf->m_count - 1; i++) {
+            leaf->m_keys[i] = leaf->m_keys[i + 1];
+            leaf->m_attrs[i] = leaf->m_attrs[i + 1];
+        }
+        leaf->m_count--;
+        leaf->m_keys[leaf->m_count] = BPT_EMPTY_KEY;
+        return true;
+    }
+
+    BPInternal* inner = static_cast<BPInternal*>(node);
+    int idx = countLessEq(inner->m_keys, BPT_INNER_KEYS, inner->m_count, id);
+    if (!removeHelper(inner->m_children[idx], id)) {
+        return false;
+    }
+    BPNode* child = inner->m_children[idx];
+    int minimum = child->isLeaf() ? BPT_MIN_LEAF : BPT_MIN_INNER;
+    if (child->m_count < minimum) {
+        rebalanceChild(inner, idx);
+    }
+    return true;
+}
+
+void BPSatNet::remove(int id){
+    if (m_root == nullptr) {
+        return;
+    }
+    removeHelper(m_root, id);
+
+    // shrink the tree when the root runs out of keys
+    if (m_root->isLeaf()) {
+        if (m_root->m_count == 0) {
+            delete static_cast<BPLeaf*>(m_root);
+            m_root = nullptr;
+            m_head = nullptr;
+        }
+    } else if (m_root->m_count == 0) {
+        BPInternal* old = static_cast<BPInternal*>(m_root);
+        m_root = old->m_children[0];
+        delete old;
+    }
+}
+
+void BPSatNet::clearHelper(BPNode* node){
+    if (node == nullptr) {
+        return;
+    }
+    if (node->isLeaf()) {
+        delete static_cast<BPLeaf*>(node);
+        return;
+    }
+    BPInternal* inner = static_cast<BPInternal*>(node);
+    for (int i = 0; i <= inner->m_count; i++) {
+        clearHelper(inner->m_children[i]);
+    }
+    delete inner;
+}
+
+void BPSatNet::clear(){
+    clearHelper(m_root);
+    m_root = nullptr;
+    m_head = nullptr;
+}
+
+// builds the tree bottom up from sorted input, every node at least half full
+void BPSatNet::bulkLoad(const std::vector<int>& ids, const std::vector<unsigned char>& attrs){
+    clear();
+    int total = (int)ids.size();
+    if (total == 0) {
+        return;
+    }
+
+    std::vector<BPNode*> level;
+    std::vector<int> lowKeys;   // smallest key under each node of the level
+    int leaves = (total + BPT_LEAF_KEYS - 1) / BPT_LEAF_KEYS;
+    BPLeaf* prev = nullptr;
+    int next = 0;
+    for (int i = 0; i < leaves; i++) {
+        int take = total / leaves + (i < total % leaves ? 1 : 0);
+        BPLeaf* leaf = new BPLeaf();
+        for (int j = 0; j < take; j++) {
+            leaf->m_keys[j] = ids[next];
+            leaf->m_attrs[j] = attrs[next];
+            next++;
+        }
+        leaf->m_count = take;
+        if (prev == nullptr) {
+            m_head = leaf;
+        } else {
+            prev->m_next = leaf;
+        }
+        prev = leaf;
+        level.push_back(leaf);
+        lowKeys.push_back(leaf->m_keys[0]);
+    }
+
+    while (level.size() > 1) {
+        int count = (int)level.size();
+        int groups = (count + BPT_INNER_KEYS) / (BPT_INNER_KEYS + 1);
+        std::vector<BPNode*> upper;
+        std::vector<int> upperKeys;
+        next = 0;
+        for (int i = 0; i < groups; i++) {
+            int take = count / groups + (i < count % groups ? 1 : 0);
+            BPInternal* inner = new BPInternal();
+            for (int j = 0; j < take; j++) {
+                inner->m_children[j] = level[next + j];
+                if (j > 0) {
+                    inner->m_keys[j - 1] = lowKeys[next + j];
+                }
+            }
+            inner->m_count = take - 1;
+            upper.push_back(inner);
+            upperKeys.push_back(lowKeys[next]);
+            next += take;
+        }
+        level.swap(upper);
+        lowKeys.swap(upperKeys);
+    }
+    m_root = level[0];
+}
+
+void BPSatNet::removeDeorbited(){
+    std::vector<int> ids;
+    std::vector<unsigned char> attrs;
+    bool found = false;
+    for (BPLeaf* leaf = m_head; leaf != nullptr; leaf = leaf->m_next) {
+        for (int i = 0; i < leaf->m_count; i++) {
+            if (((leaf->m_attrs[i] >> 4) & 3) == DEORBITED) {
+                found = true;
+            } else {
+                ids.push_back(leaf->m_keys[i]);
+                attrs.push_back(leaf->m_attrs[i]);
+            }
+        }
+    }
+    // rebuilding from the survivors is linear, unlike many single removals
+    if (found) {
+        bulkLoad(ids, attrs);
+    }
+}
+
+int BPSatNet::countSatellites(INCLIN degree) const{
+    int count = 0;
+    for (BPLeaf* leaf = m_head; leaf != nullptr; leaf = leaf->m_next) {
+        for (int i = 0; i < leaf->m_count; i++) {
+            count += (((leaf->m_attrs[i] >> 2) & 3) == degree);
+        }
+    }
+    return count;
+}
+
+void BPSatNet::listSatellites() const {
+    for (BPLeaf* leaf = m_head; leaf != nullptr; leaf = leaf->m_next) {
+        for (int i = 0; i < leaf->m_count; i++) {
+            Sat node = unpack(leaf->m_keys[i], leaf->m_attrs[i]);
+            cout << node.getID() << ": " << node.getStateStr() << ": " << node.getInclinStr() << ": " << node.getAltStr() << endl;
+        }
+    }
+}
+
+void BPSatNet::dumpTree() const {
+    dump(m_root);
+}
+
+void BPSatNet::dump(const BPNode* node) const{
+    if (node == nullptr) {
+        return;
+    }
+    cout << "[";
+    if (node->isLeaf()) {
+        const BPLeaf* leaf = static_cast<const BPLeaf*>(node);
+        for (int i = 0; i < leaf->m_count; i++) {
+            cout << (i > 0 ? " " : "") << leaf->m_keys[i];
+        }
+    } else {
+        const BPInternal* inner = static_cast<const BPInternal*>(node);
+        for (int i = 0; i <= inner->m_count; i++) {
+            dump(inner->m_children[i]);
+            if (i < inner->m_count) {
+                cout << inner->m_keys[i];
+            }
+        }
+    }
+    cout << "]";
+}
+
+const BPSatNet & BPSatNet::operator=(const BPSatNet & rhs){
+    if (this == &rhs) {
+        return *this;
+    }
+    std::vector<int> ids;
+    std::vector<unsigned char> attrs;
+    for (BPLeaf* leaf = rhs.m_head; leaf != nullptr; leaf = leaf->m_next) {
+        ids.insert(ids.end(), leaf->m_keys, leaf->m_keys + leaf->m_count);
+        attrs.insert(attrs.end(), leaf->m_attrs, leaf->m_attrs + leaf->m_count);
+    }
+    bulkLoad(ids, attrs);
+    return *this;
+}
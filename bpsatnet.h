@@ -0,0 +1,107 @@
+//
+// B+-tree alternative to the AVL based SatNet.
+// Same public interface as SatNet, but nodes are sized to one or two cache
+// lines, keys inside a node are searched with SIMD compares and the leaves
+// are linked so that in-order walks never go back up the tree.
+//
+
+#ifndef BPSATNET_H
+#define BPSATNET_H
+#include "satnet.h"
+#include <climits>
+#include <vector>
+
+// node size in bytes, either 64 (one cache line) or 128 (two cache lines)
+#ifndef BPT_NODE_BYTES
+#define BPT_NODE_BYTES 128
+#endif
+
+#if BPT_NODE_BYTES == 64
+#define BPT_LEAF_KEYS 8     // keys per leaf
+#define BPT_INNER_KEYS 4    // keys per internal node, one more child
+#elif BPT_NODE_BYTES == 128
+#define BPT_LEAF_KEYS 20
+#define BPT_INNER_KEYS 8
+#else
+#error "BPT_NODE_BYTES must be 64 or 128"
+#endif
+
+#define BPT_EMPTY_KEY INT_MAX   // unused key slots hold this so SIMD compares can scan the whole array
+
+class BPNode{
+public:
+    friend class BPSatNet;
+    friend class Tester;
+    BPNode(bool isLeaf):m_isLeaf(isLeaf), m_count(0){}
+    bool isLeaf() const {return m_isLeaf;}
+    int getCount() const {return m_count;}
+protected:
+    bool m_isLeaf;
+    unsigned char m_count;  // number of keys in use
+};
+
+class alignas(64) BPLeaf : public BPNode{
+public:
+    friend class BPSatNet;
+    friend class Tester;
+    BPLeaf():BPNode(true), m_next(nullptr){
+        for (int i = 0; i < BPT_LEAF_KEYS; i++) m_keys[i] = BPT_EMPTY_KEY;
+    }
+private:
+    int m_keys[BPT_LEAF_KEYS];              // satellite IDs, sorted
+    unsigned char m_attrs[BPT_LEAF_KEYS];   // packed altitude, inclination and state
+    BPLeaf* m_next;                         // the next leaf in key order
+};
+
+class alignas(64) BPInternal : public BPNode{
+public:
+    friend class BPSatNet;
+    friend class Tester;
+    BPInternal():BPNode(false){
+        for (int i = 0; i < BPT_INNER_KEYS; i++) m_keys[i] = BPT_EMPTY_KEY;
+        for (int i = 0; i <= BPT_INNER_KEYS; i++) m_children[i] = nullptr;
+    }
+    BPNode* getChild(int i) const {return m_children[i];}
+private:
+    int m_keys[BPT_INNER_KEYS];             // m_keys[i] separates m_children[i] and m_children[i+1]
+    BPNode* m_children[BPT_INNER_KEYS + 1];
+};
+
+static_assert(sizeof(BPLeaf) == BPT_NODE_BYTES, "leaf does not fit the node size");
+static_assert(sizeof(BPInternal) == BPT_NODE_BYTES, "internal node does not fit the node size");
+
+class BPSatNet{
+public:
+    friend class Tester;
+    BPSatNet();
+    ~BPSatNet();
+    // overloaded assignment operator
+    const BPSatNet & operator=(const BPSatNet & rhs);
+    void insert(const Sat& satellite);
+    void clear();
+    void remove(int id);
+    void dumpTree() const;
+    void listSatellites() const;
+    bool setState(int id, STATE state);
+    void removeDeorbited();//removes all deorbited satellites from the tree
+    bool findSatellite(int id) const;//returns true if the satellite is in tree
+    int countSatellites(INCLIN degree) const;
+
+private:
+    BPNode* m_root;     //the root of the B+-tree, nullptr when empty
+    BPLeaf* m_head;     //the leftmost leaf, start of the leaf chain
+
+    static unsigned char packAttrs(ALT alt, INCLIN inclin, STATE state);
+    static Sat unpack(int id, unsigned char attrs);
+    static int countLess(const int* keys, int capacity, int count, int id);
+    static int countLessEq(const int* keys, int capacity, int count, int id);
+
+    BPLeaf* findLeaf(int id) const;
+    bool insertHelper(BPNode* node, int id, unsigned char attrs, int& upKey, BPNode*& upNode);
+    bool removeHelper(BPNode* node, int id);
+    void rebalanceChild(BPInternal* parent, int idx);
+    void clearHelper(BPNode* node);
+    void dump(const BPNode* node) const;
+    void bulkLoad(const std::vector<int>& ids, const std::vector<unsigned char>& attrs);
+};
+#endif
@@ -0,0 +1,72 @@
+//
+// Change feed for SatNet mutations.
+//
+
+#include "changefeed.h"
+
+ChangeFeed::ChangeFeed(size_t capacity){
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    m_mask = size - 1;
+    m_cells = new Cell[size];
+    // each cell carries the position it is next writable at
+    for (size_t i = 0; i < size; i++) {
+        m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+    }
+    m_tail.store(0, std::memory_order_relaxed);
+    m_head.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+}
+
+ChangeFeed::~ChangeFeed(){
+    delete [] m_cells;
+}
+
+bool ChangeFeed::publish(const SatChange& change){
+    size_t pos = m_tail.load(std::memory_order_relaxed);
+    while (true) {
+        Cell& cell = m_cells[pos & m_mask];
+        size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+        long long diff = (long long)sequence - (long long)pos;
+        if (diff == 0) {
+            // the cell is free for this lap, claim it
+            if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.m_change = change;
+                cell.m_sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // the consumer has not freed this cell yet, the ring is full
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t ChangeFeed::drain(vector<SatChange>& out, size_t maxRecords){
+    size_t pos = m_head.load(std::memory_order_relaxed);
+    size_t taken = 0;
+    while (taken < maxRecords) {
+        Cell& cell = m_cells[pos & m_mask];
+        if (cell.m_sequence.load(std::memory_order_acquire) != pos + 1) {
+            break;  // empty, or the producer that claimed it is still writing
+        }
+        out.push_back(cell.m_change);
+        // hand the cell back to producers for the next lap
+        cell.m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+        pos++;
+        taken++;
+    }
+    m_head.store(pos, std::memory_order_relaxed);
+    return taken;
+}
+
+size_t ChangeFeed::getBacklog() const{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t head = m_head.load(std::memory_order_relaxed);
+    return (tail > head) ? tail - head : 0;
+}
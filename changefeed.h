@@ -0,0 +1,62 @@
+//
+// Change feed for SatNet mutations.
+// A bounded lock-free ring buffer: any number of threads may publish,
+// one consumer drains records in batches. When the ring is full a record
+// is dropped and counted, and the consumer must resync from a full copy.
+//
+
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+#include "satnet.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+enum CHANGE {INSERTED, REMOVED, STATECHANGED, RESET};   // RESET: the whole tree was replaced or cleared
+
+class SatChange{
+public:
+    SatChange(CHANGE op = RESET, int id = 0, ALT alt = DEFAULT_ALT, INCLIN inclin = DEFAULT_INCLIN, STATE state = DEFAULT_STATE)
+            :m_id(id), m_op((unsigned char)op), m_alt((unsigned char)alt), m_inclin((unsigned char)inclin), m_state((unsigned char)state){}
+    int getID() const {return m_id;}
+    CHANGE getOp() const {return static_cast<CHANGE>(m_op);}
+    ALT getAlt() const {return static_cast<ALT>(m_alt);}
+    INCLIN getInclin() const {return static_cast<INCLIN>(m_inclin);}
+    STATE getState() const {return static_cast<STATE>(m_state);}
+private:
+    int m_id;
+    unsigned char m_op;
+    unsigned char m_alt;
+    unsigned char m_inclin;
+    unsigned char m_state;
+};
+
+class ChangeFeed{
+public:
+    friend class Tester;
+    explicit ChangeFeed(size_t capacity = 1 << 16);    // rounded up to a power of two
+    ~ChangeFeed();
+    // safe from any thread, false when the ring is full and the record was dropped
+    bool publish(const SatChange& change);
+    // consumer only, moves up to maxRecords into out and returns how many
+    size_t drain(vector<SatChange>& out, size_t maxRecords = (size_t)-1);
+    // consumer only, records dropped since the last call; non-zero means resync
+    long long takeDropped() {return m_dropped.exchange(0);}
+    size_t getCapacity() const {return m_mask + 1;}
+    size_t getBacklog() const;  // records waiting, approximate while producers run
+private:
+    class Cell{
+    public:
+        std::atomic<size_t> m_sequence;
+        SatChange m_change;
+    };
+    Cell* m_cells;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_tail;     // next slot producers claim
+    alignas(64) std::atomic<size_t> m_head;     // next slot the consumer reads
+    alignas(64) std::atomic<long long> m_dropped;
+
+    ChangeFeed(const ChangeFeed&) = delete;
+    ChangeFeed& operator=(const ChangeFeed&) = delete;
+};
+#endif
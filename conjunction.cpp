@@ -0,0 +1,150 @@
+//
+// Close-approach screening over propagated catalog positions.
+//
+
+#include "conjunction.h"
+#include <algorithm>
+#include <cmath>
+
+#define CELL_BITS 20                        // per axis, beside 4 bits of shell group
+#define CELL_OFFSET (1 << (CELL_BITS - 1))  // keeps cell coordinates non-negative
+#define MIN_CELL_KM 0.02f                   // smallest cell that still fits CELL_BITS
+
+static unsigned long long cellKey(int group, int x, int y, int z){
+    const unsigned long long mask = (1ULL << CELL_BITS) - 1;
+    return (unsigned long long)group << (3 * CELL_BITS) | ((unsigned long long)(x + CELL_OFFSET) & mask) << (2 * CELL_BITS)
+           | ((unsigned long long)(y + CELL_OFFSET) & mask) << CELL_BITS | ((unsigned long long)(z + CELL_OFFSET) & mask);
+}
+
+static int cellCoord(unsigned long long key, int axis){
+    return (int)((key >> (axis * CELL_BITS)) & ((1ULL << CELL_BITS) - 1)) - CELL_OFFSET;
+}
+
+ConjunctionScreen::ConjunctionScreen(TaskPool* pool){
+    m_pool = pool;
+    m_candidates = 0;
+    m_groups = 0;
+}
+
+vector<Conjunction> ConjunctionScreen::screen(const OrbitCatalog& catalog, float threshold){
+    // neighbouring shells closer than the threshold share a grid
+    int group[4];
+    group[MI208] = 0;
+    for (int shell = MI215; shell <= MI350; shell++) {
+        double gap = OrbitCatalog::shellRadius(static_cast<ALT>(shell)) - OrbitCatalog::shellRadius(static_cast<ALT>(shell - 1));
+        group[shell] = group[shell - 1] + (gap > threshold ? 1 : 0);
+    }
+    m_groups = group[MI350] + 1;
+
+    float cell = max(threshold, MIN_CELL_KM);
+    const float* x = catalog.getX();
+    const float* y = catalog.getY();
+    const float* z = catalog.getZ();
+    m_entries.resize(catalog.size());
+    for (int i = 0; i < catalog.size(); i++) {
+        m_entries[i].m_key = cellKey(group[catalog.getShell(i)], (int)floorf(x[i] / cell),
+                                     (int)floorf(y[i] / cell), (int)floorf(z[i] / cell));
+        m_entries[i].m_index = i;
+    }
+    sort(m_entries.begin(), m_entries.end());
+    m_cellKeys.clear();
+    m_cellStart.clear();
+    for (int i = 0; i < (int)m_entries.size(); i++) {
+        if (i == 0 || m_entries[i].m_key != m_entries[i - 1].m_key) {
+            m_cellKeys.push_back(m_entries[i].m_key);
+            m_cellStart.push_back(i);
+        }
+    }
+    m_cellStart.push_back((int)m_entries.size());
+
+    int cells = (int)m_cellKeys.size();
+    int tasks = (cells + SCREEN_CELLS_PER_TASK - 1) / SCREEN_CELLS_PER_TASK;
+    vector<vector<Conjunction>> found(tasks);
+    vector<long long> candidates(tasks, 0);
+    TaskGroup taskGroup(m_pool);
+    for (int t = 0; t < tasks; t++) {
+        taskGroup.run([this, &catalog, threshold, cells, t, &found, &candidates] {
+            int first = t * SCREEN_CELLS_PER_TASK;
+            int last = min(first + SCREEN_CELLS_PER_TASK, cells);
+            screenCells(catalog, threshold, first, last, found[t], candidates[t]);
+        });
+    }
+    taskGroup.wait();
+
+    vector<Conjunction> result;
+    m_candidates = 0;
+    for (int t = 0; t < tasks; t++) {
+        result.insert(result.end(), found[t].begin(), found[t].end());
+        m_candidates += candidates[t];
+    }
+    sort(result.begin(), result.end());
+    return result;
+}
+
+void ConjunctionScreen::screenCells(const OrbitCatalog& catalog, float threshold, int first, int last,
+                                    vector<Conjunction>& found, long long& candidates) const{
+    const float* x = catalog.getX();
+    const float* y = catalog.getY();
+    const float* z = catalog.getZ();
+    float limit = threshold * threshold;
+    for (int c = first; c < last; c++) {
+        unsigned long long key = m_cellKeys[c];
+        int group = (int)(key >> (3 * CELL_BITS));
+        int cx = cellCoord(key, 2);
+        int cy = cellCoord(key, 1);
+        int cz = cellCoord(key, 0);
+        // the cell itself and the 13 neighbours that come after it in key order,
+        // so every touching pair of cells is visited once
+        for (int dx = 0; dx <= 1; dx++) {
+            for (int dy = (dx == 0) ? 0 : -1; dy <= 1; dy++) {
+                for (int dz = (dx == 0 && dy == 0) ? 0 : -1; dz <= 1; dz++) {
+                    int other = c;
+                    if (dx != 0 || dy != 0 || dz != 0) {
+                        unsigned long long neighbour = cellKey(group, cx + dx, cy + dy, cz + dz);
+                        vector<unsigned long long>::const_iterator it = lower_bound(m_cellKeys.begin() + c + 1, m_cellKeys.end(), neighbour);
+                        if (it == m_cellKeys.end() || *it != neighbour) {
+                            continue;
+                        }
+                        other = (int)(it - m_cellKeys.begin());
+                    }
+                    for (int i = m_cellStart[c]; i < m_cellStart[c + 1]; i++) {
+                        int a = m_entries[i].m_index;
+                        for (int j = (other == c) ? i + 1 : m_cellStart[other]; j < m_cellStart[other + 1]; j++) {
+                            int b = m_entries[j].m_index;
+                            float ex = x[a] - x[b];
+                            float ey = y[a] - y[b];
+                            float ez = z[a] - z[b];
+                            float squared = ex * ex + ey * ey + ez * ez;
+                            candidates++;
+                            if (squared <= limit) {
+                                int idA = catalog.getID(a);
+                                int idB = catalog.getID(b);
+                                found.push_back(Conjunction(min(idA, idB), max(idA, idB), sqrtf(squared)));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+vector<Conjunction> ConjunctionScreen::bruteForce(const OrbitCatalog& catalog, float threshold){
+    const float* x = catalog.getX();
+    const float* y = catalog.getY();
+    const float* z = catalog.getZ();
+    float limit = threshold * threshold;
+    vector<Conjunction> result;
+    for (int a = 0; a < catalog.size(); a++) {
+        for (int b = a + 1; b < catalog.size(); b++) {
+            float ex = x[a] - x[b];
+            float ey = y[a] - y[b];
+            float ez = z[a] - z[b];
+            float squared = ex * ex + ey * ey + ez * ez;
+            if (squared <= limit) {
+                result.push_back(Conjunction(catalog.getID(a), catalog.getID(b), sqrtf(squared)));
+            }
+        }
+    }
+    return result;
+}
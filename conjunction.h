@@ -0,0 +1,59 @@
+//
+// Close-approach screening over propagated catalog positions.
+// Orbits are circular, so two satellites in shells whose radii differ by
+// more than the threshold can never be that close; shells are grouped by
+// that gap and each group gets its own uniform grid with cells as wide as
+// the threshold. A pair can then only be close if its cells touch, so
+// each cell is checked against itself and its 13 forward neighbours, and
+// the cells are split over the task pool.
+//
+
+#ifndef CONJUNCTION_H
+#define CONJUNCTION_H
+#include "orbitcatalog.h"
+#include <vector>
+
+#define SCREEN_CELLS_PER_TASK 1024  // grid cells one task checks
+
+class Conjunction{
+public:
+    Conjunction(int first = 0, int second = 0, float distance = 0)
+            :m_first(first), m_second(second), m_distance(distance){}
+    int m_first;        // the smaller satellite ID
+    int m_second;
+    float m_distance;   // km
+    bool operator<(const Conjunction& rhs) const{
+        return (m_first != rhs.m_first) ? m_first < rhs.m_first : m_second < rhs.m_second;
+    }
+};
+
+class ConjunctionScreen{
+public:
+    friend class Tester;
+    explicit ConjunctionScreen(TaskPool* pool = nullptr);
+    // pairs of satellites within threshold km at the time the catalog was last
+    // propagated to, sorted by ID
+    vector<Conjunction> screen(const OrbitCatalog& catalog, float threshold);
+    // checks every pair, for testing the grid
+    static vector<Conjunction> bruteForce(const OrbitCatalog& catalog, float threshold);
+    long long getCandidates() const {return m_candidates;}  // distance checks of the last screen
+    int getGroups() const {return m_groups;}                // shell groups of the last screen
+
+private:
+    class Entry{
+    public:
+        unsigned long long m_key;   // shell group and cell coordinates
+        int m_index;                // into the catalog
+        bool operator<(const Entry& rhs) const {return m_key < rhs.m_key;}
+    };
+    TaskPool* m_pool;               // not owned
+    vector<Entry> m_entries;        // sorted by cell
+    vector<unsigned long long> m_cellKeys;
+    vector<int> m_cellStart;        // first entry of each cell, plus one past the end
+    long long m_candidates;
+    int m_groups;
+
+    void screenCells(const OrbitCatalog& catalog, float threshold, int first, int last,
+                     vector<Conjunction>& found, long long& candidates) const;
+};
+#endif
@@ -0,0 +1,198 @@
+//
+// Time-driven state transitions for the satellites of a SatNet.
+//
+
+#include "decayscheduler.h"
+#include <algorithm>
+
+DecayScheduler::DecayScheduler(SatNet& network, long long startTime):m_network(network){
+    m_now = startTime;
+    m_pending = 0;
+    m_free = -1;
+    m_overflow = -1;
+    m_due = -1;
+    m_history = nullptr;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        m_levelCount[level] = 0;
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+            m_slots[level][slot] = -1;
+        }
+    }
+}
+
+int DecayScheduler::allocEvent(){
+    if (m_free == -1) {
+        m_events.push_back(Event());
+        return (int)m_events.size() - 1;
+    }
+    int index = m_free;
+    m_free = m_events[index].m_next;
+    return index;
+}
+
+// links the event into the slot that covers its time
+void DecayScheduler::place(int index){
+    Event& event = m_events[index];
+    long long delta = event.m_time - m_now;
+    if (delta <= 0) {
+        event.m_next = m_due;
+        m_due = index;
+        return;
+    }
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        if (delta < (1LL << (WHEEL_BITS * (level + 1)))) {
+            int slot = (int)((event.m_time >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+            event.m_next = m_slots[level][slot];
+            m_slots[level][slot] = index;
+            m_levelCount[level]++;
+            return;
+        }
+    }
+    event.m_next = m_overflow;
+    m_overflow = index;
+}
+
+void DecayScheduler::schedule(int id, long long time, STATE state){
+    int index = allocEvent();
+    PerID& perID = m_ids[id];
+    Event& event = m_events[index];
+    event.m_id = id;
+    event.m_generation = perID.m_generation;
+    event.m_time = time;
+    event.m_state = state;
+    perID.m_pending++;
+    perID.m_queued++;
+    m_pending++;
+    place(index);
+}
+
+int DecayScheduler::cancel(int id){
+    unordered_map<int, PerID>::iterator it = m_ids.find(id);
+    if (it == m_ids.end()) {
+        return 0;
+    }
+    // queued events of the old generation are dropped when they come due
+    int cancelled = it->second.m_pending;
+    it->second.m_generation++;
+    it->second.m_pending = 0;
+    m_pending -= cancelled;
+    return cancelled;
+}
+
+// moves the current slot of a level down to the levels below it
+void DecayScheduler::cascade(int level){
+    int slot = (int)((m_now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+    int index = m_slots[level][slot];
+    m_slots[level][slot] = -1;
+    while (index != -1) {
+        int next = m_events[index].m_next;
+        m_levelCount[level]--;
+        place(index);
+        index = next;
+    }
+}
+
+// takes every event of a list, keeps the live ones and frees the nodes
+void DecayScheduler::collectList(int head){
+    int index = head;
+    while (index != -1) {
+        Event& event = m_events[index];
+        int next = event.m_next;
+        unordered_map<int, PerID>::iterator it = m_ids.find(event.m_id);
+        if (event.m_generation == it->second.m_generation) {
+            it->second.m_pending--;
+            m_pending--;
+            m_fired.push_back(event);
+        }
+        if (--it->second.m_queued == 0) {
+            m_ids.erase(it);
+        }
+        event.m_next = m_free;
+        m_free = index;
+        index = next;
+    }
+}
+
+void DecayScheduler::fireSlot(int slot){
+    int head = m_slots[0][slot];
+    m_slots[0][slot] = -1;
+    for (int index = head; index != -1; index = m_events[index].m_next) {
+        m_levelCount[0]--;
+    }
+    collectList(head);
+}
+
+int DecayScheduler::advanceTo(long long time, bool purgeDeorbited){
+    m_fired.clear();
+    int due = m_due;
+    m_due = -1;
+    collectList(due);
+
+    const long long topSpan = 1LL << (WHEEL_BITS * WHEEL_LEVELS);
+    while (m_now < time) {
+        // jump straight to the next boundary of the lowest level holding events
+        int lowest = 0;
+        while (lowest < WHEEL_LEVELS && m_levelCount[lowest] == 0) {
+            lowest++;
+        }
+        if (lowest == WHEEL_LEVELS && m_overflow == -1) {
+            m_now = time;
+            break;
+        }
+        long long step = 1LL << (WHEEL_BITS * lowest);
+        long long next = (m_now / step + 1) * step;
+        if (next > time) {
+            m_now = time;
+            break;
+        }
+        m_now = next;
+
+        if (m_now % topSpan == 0 && m_overflow != -1) {
+            int index = m_overflow;
+            m_overflow = -1;
+            while (index != -1) {
+                int following = m_events[index].m_next;
+                place(index);
+                index = following;
+            }
+        }
+        for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+            if (m_now % (1LL << (WHEEL_BITS * level)) == 0) {
+                cascade(level);
+            }
+        }
+        fireSlot((int)(m_now & (WHEEL_SLOTS - 1)));
+        if (m_due != -1) {
+            // events cascaded onto the current tick
+            due = m_due;
+            m_due = -1;
+            collectList(due);
+        }
+    }
+
+    if (m_fired.empty()) {
+        return 0;
+    }
+
+    // one batch sorted by ID, the latest transition of each satellite wins
+    stable_sort(m_fired.begin(), m_fired.end(), [](const Event& a, const Event& b) {
+        return (a.m_id != b.m_id) ? a.m_id < b.m_id : a.m_time < b.m_time;
+    });
+    vector<pair<int, STATE>> batch;
+    bool deorbits = false;
+    for (size_t i = 0; i < m_fired.size(); i++) {
+        if (m_history != nullptr && m_network.getHandle(m_fired[i].m_id) != nullptr) {
+            m_history->append(m_fired[i].m_id, m_fired[i].m_time, m_fired[i].m_state);
+        }
+        if (i + 1 < m_fired.size() && m_fired[i + 1].m_id == m_fired[i].m_id) {
+            continue;
+        }
+        batch.push_back(make_pair(m_fired[i].m_id, m_fired[i].m_state));
+        deorbits = deorbits || m_fired[i].m_state == DEORBITED;
+    }
+    int applied = m_network.setStates(batch);
+    if (purgeDeorbited && deorbits) {
+        m_network.removeDeorbited();
+    }
+    return applied;
+}
@@ -0,0 +1,73 @@
+//
+// Time-driven state transitions for the satellites of a SatNet.
+// Pending transitions sit in a hierarchical timer wheel, so scheduling is
+// O(1) and advancing only touches slots that hold events. Times are
+// non-negative ticks in whatever unit the caller uses.
+//
+
+#ifndef DECAYSCHEDULER_H
+#define DECAYSCHEDULER_H
+#include "satnet.h"
+#include "statehistory.h"
+#include <unordered_map>
+#include <vector>
+
+#define WHEEL_LEVELS 4      // levels of the timer wheel
+#define WHEEL_BITS 8        // each level has 2^WHEEL_BITS slots
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+
+class DecayScheduler{
+public:
+    friend class Tester;
+    explicit DecayScheduler(SatNet& network, long long startTime = 0);
+    // queues a state change for the satellite at the given time, a time
+    // that has already passed is applied on the next advanceTo
+    void schedule(int id, long long time, STATE state);
+    // drops every pending transition of the satellite, returns how many
+    int cancel(int id);
+    // applies every transition due up to time in one ID sorted batch, and
+    // purges deorbited satellites afterwards if asked to; returns how many
+    // transitions reached a satellite in the network
+    int advanceTo(long long time, bool purgeDeorbited = false);
+    long long getTime() const {return m_now;}
+    long long getPending() const {return m_pending;}
+    // records every transition that reaches a satellite at its scheduled
+    // time, including ones overtaken within the same advance; nullptr stops
+    void setHistory(StateHistory* history) {m_history = history;}
+
+private:
+    class Event{
+    public:
+        int m_id;
+        int m_generation;   // matches the ID's generation unless cancelled
+        long long m_time;
+        STATE m_state;
+        int m_next;         // next event in the same slot, -1 at the end
+    };
+    class PerID{
+    public:
+        int m_generation = 0;
+        int m_pending = 0;  // live events of this ID
+        int m_queued = 0;   // events in the wheel including cancelled ones
+    };
+
+    SatNet& m_network;
+    long long m_now;        // every tick up to and including m_now is processed
+    long long m_pending;
+    vector<Event> m_events; // event pool, slots link into it by index
+    int m_free;             // first free event of the pool
+    int m_slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    int m_levelCount[WHEEL_LEVELS];
+    int m_overflow;         // events beyond the reach of the top level
+    int m_due;              // events already due, applied on the next advance
+    unordered_map<int, PerID> m_ids;
+    vector<Event> m_fired;  // events collected during one advance
+    StateHistory* m_history;    // not owned
+
+    int allocEvent();
+    void place(int index);
+    void cascade(int level);
+    void fireSlot(int slot);
+    void collectList(int head);
+};
+#endif
@@ -1,11 +1,28 @@
 #include "satnet.h"
+#include "bpsatnet.h"
+#include "decayscheduler.h"
+#include "changefeed.h"
+#include "satrace.h"
+#include "shardedsatnet.h"
+#include "statehistory.h"
+#include "orbitcatalog.h"
+#include "conjunction.h"
 #include <math.h>
 #include <algorithm>
 #include <random>
 #include <vector>
+#include <set>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 using namespace std;
 
-enum RANDOM {UNIFORMINT, UNIFORMREAL, NORMAL, SHUFFLE};
+enum RANDOM {UNIFORMINT, UNIFORMREAL, NORMAL, SHUFFLE, ZIPFIAN, SEQBURST};
+#define DEFAULT_ZIPF_EXPONENT 0.99
+#define DEFAULT_BURST_LENGTH 64
 class Random {
 public:
     Random(int min, int max, RANDOM type=UNIFORMINT, int mean=50, int stdev=20) : m_min(min), m_max(max), m_type(type)
@@ -29,10 +46,43 @@ public:
             m_generator = std::mt19937(10);// 10 is the fixed seed value
             m_uniReal = std::uniform_real_distribution<double>((double)min,(double)max);
         }
+        else if (type == ZIPFIAN) {
+            //the case of ZIPFIAN to generate integer numbers where a few values are very popular
+            //the popularity ranks are spread over the range by a fixed shuffle
+            m_generator = std::mt19937(10);// 10 is the fixed seed value
+            setZipfExponent(DEFAULT_ZIPF_EXPONENT);
+        }
+        else if (type == SEQBURST) {
+            //the case of SEQBURST to generate runs of consecutive numbers from random starting points
+            m_generator = std::mt19937(10);// 10 is the fixed seed value
+            m_unidist = std::uniform_int_distribution<>(min,max);
+            setBurstLength(DEFAULT_BURST_LENGTH);
+        }
         else { //the case of SHUFFLE to generate every number only once
             m_generator = std::mt19937(m_device());
         }
     }
+    void setZipfExponent(double exponent){
+        // the higher the exponent the more skewed the popularity
+        m_zipfCdf.clear();
+        m_zipfValues.clear();
+        double total = 0;
+        for (int rank = 1; rank <= m_max - m_min + 1; rank++){
+            total += 1.0 / pow(rank, exponent);
+            m_zipfCdf.push_back(total);
+            m_zipfValues.push_back(m_min + rank - 1);
+        }
+        for (size_t i = 0; i < m_zipfCdf.size(); i++){
+            m_zipfCdf[i] /= total;
+        }
+        std::shuffle(m_zipfValues.begin(), m_zipfValues.end(), m_generator);
+    }
+    void setBurstLength(int maxLength){
+        // every burst has a length between 1 and maxLength
+        m_burstMax = maxLength;
+        m_burstLeft = 0;
+        m_burstNext = m_min;
+    }
     void setSeed(int seedNum){
         // we have set a default value for seed in constructor
         // we can change the seed by calling this function after constructor call
@@ -80,6 +130,23 @@ public:
             //this will generate a random number between min and max values
             result = m_unidist(m_generator);
         }
+        else if (m_type == ZIPFIAN){
+            //picks a popularity rank by inverting the cumulative distribution
+            double u = std::uniform_real_distribution<double>(0.0, 1.0)(m_generator);
+            size_t rank = std::lower_bound(m_zipfCdf.begin(), m_zipfCdf.end(), u) - m_zipfCdf.begin();
+            if (rank >= m_zipfValues.size()) rank = m_zipfValues.size() - 1;
+            result = m_zipfValues[rank];
+        }
+        else if (m_type == SEQBURST){
+            //continues the current burst, or starts a new one at a random number
+            if (m_burstLeft == 0){
+                m_burstNext = m_unidist(m_generator);
+                m_burstLeft = std::uniform_int_distribution<>(1, m_burstMax)(m_generator);
+            }
+            result = m_burstNext;
+            m_burstNext = (m_burstNext == m_max) ? m_min : m_burstNext + 1;
+            m_burstLeft--;
+        }
         return result;
     }
 
@@ -103,6 +170,11 @@ public:
     std::normal_distribution<> m_normdist;//normal distribution
     std::uniform_int_distribution<> m_unidist;//integer uniform distribution
     std::uniform_real_distribution<double> m_uniReal;//real uniform distribution
+    vector<double> m_zipfCdf;//cumulative popularity of each rank
+    vector<int> m_zipfValues;//the number behind each popularity rank
+    int m_burstMax = DEFAULT_BURST_LENGTH;//longest burst
+    int m_burstLeft = 0;//numbers left in the current burst
+    int m_burstNext = 0;//next number of the current burst
 };
 
 class Tester{
@@ -127,18 +199,84 @@ class Tester{
     bool testSetState();
 
     bool testRemovalPerformance();
+
+    bool testBPTreeInsertRemove();
+    bool testBPTreeDeorbited();
+    bool testParallelBuildCopyClear();
+    bool testParallelReduce();
+    bool testLazyRemoval();
+    bool testDecayScheduler();
+    bool testChangeFeed();
+    bool testChangeFeedProducers();
+    bool testRandomGenerators();
+    bool testTraceRecordReplay();
+    bool testLookupCache();
+    bool testCursorInsertAndWalk();
+    bool testStableHandles();
+    bool testShardedSatNet();
+    bool testPresenceBitmap();
+    bool testStateHistory();
+    bool testOrbitPropagation();
+    bool testConjunctionScreen();
+    bool testBalancePolicy();
+    bool testEnumMetadata();
+    bool testTraceCopyAndBuild();
+
+    // benchmarks, run with "bench" as the first argument
+    void benchBPTreeVsAVL();
+    void benchParallelBuildCopyClear();
+    void benchParallelReduce();
+    void benchLazyRemoval();
+    void benchDecayScheduler();
+    void benchTraceReplay(const string& path);
+    void benchLookupCache();
+    void benchCursorInsert();
+    void benchHandleUpdates();
+    void benchShardedScaling();
+    void benchPresenceBitmap();
+    void benchStateHistory();
+    void benchOrbitPropagation();
+    void benchConjunctionScreen();
+    void benchBalancePolicy();
 };
 
+// the rank of a possibly missing node, its height under AVL
+int rankOf(const Sat* node) {
+    return (node != nullptr) ? node->getHeight() : 0;
+}
+
+// checks the rank rule of the compiled balancing policy at one node
+bool rankRuleHolds(const Sat* node) {
+    int leftDiff = node->getHeight() - rankOf(node->getLeft());
+    int rightDiff = node->getHeight() - rankOf(node->getRight());
+#if SATNET_BALANCE == BALANCE_AVL
+    return abs(leftDiff - rightDiff) <= 1;
+#elif SATNET_BALANCE == BALANCE_REDBLACK
+    // a red child has its parent's rank and only black children, a black one is a rank lower
+    if (node->getHeight() < 1 || leftDiff < 0 || leftDiff > 1 || rightDiff < 0 || rightDiff > 1) {
+        return false;
+    }
+    for (const Sat* child : {node->getLeft(), node->getRight()}) {
+        if (rankOf(child) == node->getHeight()
+            && (rankOf(child->getLeft()) == node->getHeight() || rankOf(child->getRight()) == node->getHeight())) {
+            return false;
+        }
+    }
+    return true;
+#else
+    if (node->getLeft() == nullptr && node->getRight() == nullptr && node->getHeight() != 1) {
+        return false;
+    }
+    return leftDiff >= 1 && leftDiff <= 2 && rightDiff >= 1 && rightDiff <= 2;
+#endif
+}
+
 bool isTreeBalanced(Sat* node) {
     if (node == nullptr) {
         return true;
     }
 
-    int leftHeight = (node->getLeft() != nullptr) ? node->getLeft()->getHeight() : 0;
-    int rightHeight = (node->getRight() != nullptr) ? node->getRight()->getHeight() : 0;
-    int balance = leftHeight - rightHeight;
-
-    if (abs(balance) > 1) {
+    if (!rankRuleHolds(node)) {
         return false; // Tree is not balanced
     }
 
@@ -161,9 +299,75 @@ bool isBST(Sat* node) {
     return isBST(node->getLeft()) && isBST(node->getRight());
 }
 
-int main(){
+// checks that every stored rank is right for its subtree: the real height
+// under AVL, otherwise a rank that follows the policy's rule
+int checkedHeight(Sat* node, bool& correct) {
+    if (node == nullptr) {
+        return 0;
+    }
+    int height = 1 + max(checkedHeight(node->getLeft(), correct), checkedHeight(node->getRight(), correct));
+#if SATNET_BALANCE == BALANCE_AVL
+    if (height != node->getHeight()) {
+        correct = false;
+    }
+#else
+    if (!rankRuleHolds(node)) {
+        correct = false;
+    }
+#endif
+    return height;
+}
+
+// checks key order, fill factor and uniform leaf depth of a B+-tree
+bool isValidBPTree(BPNode* node, int depth, int& leafDepth, bool isRoot) {
+    if (node == nullptr) {
+        return true;
+    }
+    if (node->isLeaf()) {
+        if (leafDepth == -1) {
+            leafDepth = depth;
+        }
+        if (!isRoot && node->getCount() < BPT_LEAF_KEYS / 2) {
+            return false;
+        }
+        return leafDepth == depth;
+    }
+    if (!isRoot && node->getCount() < BPT_INNER_KEYS / 2) {
+        return false;
+    }
+    BPInternal* inner = static_cast<BPInternal*>(node);
+    for (int i = 0; i <= inner->getCount(); i++) {
+        if (!isValidBPTree(inner->getChild(i), depth + 1, leafDepth, false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
     Tester tester;
 
+    if (argc > 1 && string(argv[1]) == "bench") {
+        // an optional second argument picks a single benchmark
+        string which = (argc > 2) ? argv[2] : "all";
+        if (which == "all" || which == "bptree") tester.benchBPTreeVsAVL();
+        if (which == "all" || which == "parallel") tester.benchParallelBuildCopyClear();
+        if (which == "all" || which == "reduce") tester.benchParallelReduce();
+        if (which == "all" || which == "lazy") tester.benchLazyRemoval();
+        if (which == "all" || which == "scheduler") tester.benchDecayScheduler();
+        if (which == "all" || which == "trace") tester.benchTraceReplay((argc > 3) ? argv[3] : "synthetic.trace");
+        if (which == "all" || which == "cache") tester.benchLookupCache();
+        if (which == "all" || which == "cursor") tester.benchCursorInsert();
+        if (which == "all" || which == "handles") tester.benchHandleUpdates();
+        if (which == "all" || which == "sharded") tester.benchShardedScaling();
+        if (which == "all" || which == "bitmap") tester.benchPresenceBitmap();
+        if (which == "all" || which == "history") tester.benchStateHistory();
+        if (which == "all" || which == "orbit") tester.benchOrbitPropagation();
+        if (which == "all" || which == "conjunction") tester.benchConjunctionScreen();
+        if (which == "all" || which == "balance") tester.benchBalancePolicy();
+        return 0;
+    }
+
     cout << "insert test: " << endl;
     cout << tester.testInsertion() << endl;
     cout << tester.testEdgeInsertion() << endl;
@@ -198,6 +402,61 @@ int main(){
 
     cout << "Assignment Operator Test" << endl;
     cout << tester.testAssignmentOperatorErrorCase() << endl;
+
+    cout << "B+-tree test" << endl;
+    cout << tester.testBPTreeInsertRemove() << endl;
+    cout << tester.testBPTreeDeorbited() << endl;
+
+    cout << "Parallel test" << endl;
+    cout << tester.testParallelBuildCopyClear() << endl;
+    cout << tester.testParallelReduce() << endl;
+
+    cout << "Lazy removal test" << endl;
+    cout << tester.testLazyRemoval() << endl;
+
+    cout << "Scheduler test" << endl;
+    cout << tester.testDecayScheduler() << endl;
+
+    cout << "Change feed test" << endl;
+    cout << tester.testChangeFeed() << endl;
+    cout << tester.testChangeFeedProducers() << endl;
+
+    cout << "Trace test" << endl;
+    cout << tester.testRandomGenerators() << endl;
+    cout << tester.testTraceRecordReplay() << endl;
+
+    cout << "Cache test" << endl;
+    cout << tester.testLookupCache() << endl;
+
+    cout << "Cursor test" << endl;
+    cout << tester.testCursorInsertAndWalk() << endl;
+
+    cout << "Handle test" << endl;
+    cout << tester.testStableHandles() << endl;
+
+    cout << "Sharded test" << endl;
+    cout << tester.testShardedSatNet() << endl;
+
+    cout << "Bitmap test" << endl;
+    cout << tester.testPresenceBitmap() << endl;
+
+    cout << "History test" << endl;
+    cout << tester.testStateHistory() << endl;
+
+    cout << "Orbit test" << endl;
+    cout << tester.testOrbitPropagation() << endl;
+
+    cout << "Conjunction test" << endl;
+    cout << tester.testConjunctionScreen() << endl;
+
+    cout << "Balance policy test" << endl;
+    cout << tester.testBalancePolicy() << endl;
+
+    cout << "Enum metadata test" << endl;
+    cout << tester.testEnumMetadata() << endl;
+
+    cout << "Trace copy and build test" << endl;
+    cout << tester.testTraceCopyAndBuild() << endl;
     return 0;
 }
 
@@ -593,3 +852,1707 @@ bool Tester :: testInsertPerformance() {
     return ((expectedRatio - acceptableRange) < T2 / (2 * T1) < (expectedRatio + acceptableRange));
 
 }
+
+
+bool Tester::testBPTreeInsertRemove() {
+    Random idGen(MINID, MAXID);
+    BPSatNet network;
+    set<int> expected;
+
+    for (int i = 0; i < 5000; i++) {
+        int id = idGen.getRandNum();
+        network.insert(Sat(id));
+        expected.insert(id);
+    }
+
+    // remove every other inserted ID, this forces borrows and merges
+    bool toggle = false;
+    for (set<int>::iterator it = expected.begin(); it != expected.end();) {
+        if (toggle) {
+            network.remove(*it);
+            it = expected.erase(it);
+        } else {
+            it++;
+        }
+        toggle = !toggle;
+    }
+
+    int leafDepth = -1;
+    if (!isValidBPTree(network.m_root, 0, leafDepth, true)) {
+        return false;
+    }
+
+    // the leaf chain must list exactly the remaining IDs in order
+    set<int>::iterator it = expected.begin();
+    for (BPLeaf* leaf = network.m_head; leaf != nullptr; leaf = leaf->m_next) {
+        for (int i = 0; i < leaf->getCount(); i++) {
+            if (it == expected.end() || *it != leaf->m_keys[i]) {
+                return false;
+            }
+            it++;
+        }
+    }
+    if (it != expected.end()) {
+        return false;
+    }
+
+    for (int id = MINID; id <= MAXID; id += 7) {
+        if (network.findSatellite(id) != (expected.count(id) == 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testBPTreeDeorbited() {
+    BPSatNet network;
+    for (int i = 0; i < 1000; i++) {
+        network.insert(Sat(MINID + i, MI208, static_cast<INCLIN>(i % 4), ACTIVE));
+    }
+    // deorbit every I53 satellite
+    for (int i = 1; i < 1000; i += 4) {
+        if (!network.setState(MINID + i, DEORBITED)) {
+            return false;
+        }
+    }
+
+    BPSatNet copy;
+    copy = network;
+    network.removeDeorbited();
+
+    if (network.countSatellites(I53) != 0 || network.countSatellites(I48) != 250) {
+        return false;
+    }
+    if (copy.countSatellites(I53) != 250 || network.findSatellite(MINID + 1)) {
+        return false;
+    }
+    int leafDepth = -1;
+    return isValidBPTree(network.m_root, 0, leafDepth, true);
+}
+
+// compares shape, IDs and heights of two trees
+bool sameTree(const Sat* a, const Sat* b) {
+    if (a == nullptr || b == nullptr) {
+        return a == b;
+    }
+    return a->getID() == b->getID() && a->getHeight() == b->getHeight() && a->getState() == b->getState()
+           && sameTree(a->getLeft(), b->getLeft()) && sameTree(a->getRight(), b->getRight());
+}
+
+bool Tester::testParallelBuildCopyClear() {
+    TaskPool pool(4);
+    const int netSize = 150000;
+
+    vector<Sat> sorted;
+    for (int i = 0; i < netSize; i++) {
+        sorted.push_back(Sat(i, MI208, static_cast<INCLIN>(i % 4), (i % 3 == 0) ? DECAYING : ACTIVE));
+    }
+
+    SatNet network;
+    network.setTaskPool(&pool);
+    network.buildFromSorted(sorted);
+    if (!isTreeBalanced(network.m_root) || !isBST(network.m_root) || network.countSatellites(I70) != netSize / 4) {
+        return false;
+    }
+
+    // parallel copy must give the exact same tree as the sequential one
+    SatNet parallelCopy;
+    SatNet sequentialCopy;
+    parallelCopy.setTaskPool(&pool);
+    parallelCopy = network;
+    sequentialCopy = network;
+    if (!sameTree(parallelCopy.m_root, network.m_root) || !sameTree(sequentialCopy.m_root, network.m_root)) {
+        return false;
+    }
+
+    // the built tree must keep working as a normal AVL tree
+    network.remove(netSize / 2);
+    network.insert(Sat(netSize + 1));
+    if (network.findSatellite(netSize / 2) || !network.findSatellite(netSize + 1) || !isTreeBalanced(network.m_root)) {
+        return false;
+    }
+
+    parallelCopy.clear();
+    return parallelCopy.m_root == nullptr && parallelCopy.countSatellites(I48) == 0;
+}
+
+bool Tester::testParallelReduce() {
+    TaskPool pool(4);
+    const int netSize = 120000;
+    vector<Sat> sorted;
+    for (int i = 0; i < netSize; i++) {
+        sorted.push_back(Sat(i, static_cast<ALT>((i / 7) % 4), static_cast<INCLIN>(i % 4), (i % 5 == 0) ? DECAYING : ACTIVE));
+    }
+    SatNet sequential;
+    SatNet parallel;
+    sequential.buildFromSorted(sorted);
+    parallel.setTaskPool(&pool);
+    parallel.buildFromSorted(sorted);
+
+    // histogram by altitude must match the sequential fold
+    auto fold = [](vector<int>& hist, const Sat& satellite) {hist[satellite.getAlt()]++;};
+    auto combine = [](vector<int>& hist, vector<int>& right) {
+        for (size_t i = 0; i < hist.size(); i++) hist[i] += right[i];
+    };
+    if (parallel.parallelReduce(vector<int>(4, 0), fold, combine) != sequential.parallelReduce(vector<int>(4, 0), fold, combine)) {
+        return false;
+    }
+    if (parallel.countSatellites(I97) != netSize / 4 || sequential.countSatellites(I97) != netSize / 4) {
+        return false;
+    }
+
+    // ordered collection lists the decaying IDs ascending, unordered the same set
+    auto decaying = [](const Sat& satellite) {return satellite.getState() == DECAYING;};
+    vector<const Sat*> ordered = parallel.collectSatellites(decaying);
+    vector<const Sat*> unordered = parallel.collectSatellites(decaying, false);
+    if ((int)ordered.size() != netSize / 5 || unordered.size() != ordered.size()) {
+        return false;
+    }
+    vector<int> unorderedIDs;
+    for (size_t i = 0; i < ordered.size(); i++) {
+        if (ordered[i]->getID() != (int)i * 5) {
+            return false;
+        }
+        unorderedIDs.push_back(unordered[i]->getID());
+    }
+    sort(unorderedIDs.begin(), unorderedIDs.end());
+    for (size_t i = 0; i < unorderedIDs.size(); i++) {
+        if (unorderedIDs[i] != (int)i * 5) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testLazyRemoval() {
+    SatNet network;
+    network.setLazyRemoval(true, 0.25);
+    for (int i = 0; i < 1000; i++) {
+        network.insert(Sat(MINID + i, MI208, static_cast<INCLIN>(i % 4)));
+    }
+
+    // 200 removals stay below the ratio, they only leave tombstones
+    for (int i = 0; i < 1000; i += 5) {
+        network.remove(MINID + i);
+    }
+    if (network.getTombstones() != 200 || network.m_nodes != 1000) {
+        return false;
+    }
+    if (network.findSatellite(MINID) || network.setState(MINID + 5, DECAYING) || network.countSatellites(I48) != 200) {
+        return false;
+    }
+
+    // inserting a removed ID revives its node with the new payload
+    network.insert(Sat(MINID, MI350, I97));
+    if (!network.findSatellite(MINID) || network.getTombstones() != 199 || network.countSatellites(I97) != 201) {
+        return false;
+    }
+
+    // crossing the ratio compacts the tree in one pass
+    for (int i = 1; i < 1000; i += 5) {
+        network.remove(MINID + i);
+    }
+    if (network.getTombstones() >= 250 || !isTreeBalanced(network.m_root) || !isBST(network.m_root)) {
+        return false;
+    }
+    network.setLazyRemoval(false);
+    return network.getTombstones() == 0 && network.m_nodes == 601 && !network.findSatellite(MINID + 1)
+           && network.findSatellite(MINID + 2);
+}
+
+bool Tester::testDecayScheduler() {
+    SatNet network;
+    for (int i = 0; i < 100; i++) {
+        network.insert(Sat(MINID + i));
+    }
+    DecayScheduler scheduler(network);
+
+    // every satellite decays at 1000 and deorbits at 70000, the second
+    // transition starts two levels up the wheel and has to cascade down
+    for (int i = 0; i < 100; i++) {
+        scheduler.schedule(MINID + i, 1000, DECAYING);
+        scheduler.schedule(MINID + i, 70000, DEORBITED);
+    }
+    scheduler.schedule(MINID, 5000000000LL, ACTIVE);    // beyond the top level
+    scheduler.schedule(MAXID, 1000, DECAYING);          // not in the network
+    if (scheduler.cancel(MINID + 99) != 2 || scheduler.getPending() != 200) {
+        return false;
+    }
+
+    if (scheduler.advanceTo(999) != 0 || network.countSatellites(I48) != 100) {
+        return false;
+    }
+    if (scheduler.advanceTo(1000) != 99) {
+        return false;
+    }
+    int decaying = network.collectSatellites([](const Sat& s) {return s.getState() == DECAYING;}).size();
+    if (decaying != 99) {
+        return false;
+    }
+
+    // the cancelled satellite stays active and is not purged
+    if (scheduler.advanceTo(100000, true) != 99 || network.countSatellites(I48) != 1 || !network.findSatellite(MINID + 99)) {
+        return false;
+    }
+
+    // the overflow event only fires once its time comes, its satellite is gone by then
+    if (scheduler.getPending() != 1 || scheduler.advanceTo(4999999999LL) != 0 || scheduler.getPending() != 1) {
+        return false;
+    }
+    scheduler.schedule(MINID + 99, 0, DECAYING);        // already in the past
+    if (scheduler.advanceTo(5000000000LL) != 1 || scheduler.getPending() != 0) {
+        return false;
+    }
+    return network.setState(MINID + 99, ACTIVE) && isTreeBalanced(network.m_root);
+}
+
+bool Tester::testChangeFeed() {
+    SatNet network;
+    ChangeFeed feed(8);
+    network.subscribe(&feed);
+
+    network.insert(Sat(1001, MI340, I70));
+    network.insert(Sat(1001, MI208, I48));  // duplicate, no record
+    network.insert(Sat(1002));
+    network.setState(1002, DEORBITED);
+    network.setState(999, DECAYING);        // missing, no record
+    network.remove(1001);
+    network.remove(1001);                   // already gone, no record
+    network.removeDeorbited();
+
+    vector<SatChange> changes;
+    if (feed.drain(changes) != 5 || feed.takeDropped() != 0) {
+        return false;
+    }
+    if (changes[0].getOp() != INSERTED || changes[0].getID() != 1001 || changes[0].getInclin() != I70
+        || changes[2].getOp() != STATECHANGED || changes[2].getState() != DEORBITED
+        || changes[3].getOp() != REMOVED || changes[3].getID() != 1001
+        || changes[4].getOp() != REMOVED || changes[4].getID() != 1002) {
+        return false;
+    }
+
+    // a full ring drops records and tells the consumer to resync
+    for (int i = 0; i < 10; i++) {
+        network.insert(Sat(2000 + i));
+    }
+    changes.clear();
+    if (feed.drain(changes) != 8 || feed.takeDropped() != 2 || feed.takeDropped() != 0) {
+        return false;
+    }
+
+    SatNet copy;
+    copy = network;
+    copy.subscribe(&feed);
+    copy.clear();
+    network.unsubscribe(&feed);
+    network.insert(Sat(3000));
+    changes.clear();
+    return feed.drain(changes) == 1 && changes[0].getOp() == RESET && feed.getBacklog() == 0;
+}
+
+bool Tester::testChangeFeedProducers() {
+    const int producers = 4;
+    const int perProducer = 20000;
+    ChangeFeed feed(1024);
+    atomic<int> finished(0);
+
+    vector<thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(thread([&feed, &finished, p] {
+            for (int i = 0; i < perProducer; i++) {
+                // spin on a full ring, every record must get through
+                while (!feed.publish(SatChange(INSERTED, p * perProducer + i))) {
+                    this_thread::yield();
+                }
+            }
+            finished++;
+        }));
+    }
+
+    // records of one producer must come out in the order it published them
+    vector<int> last(producers, -1);
+    vector<SatChange> changes;
+    int received = 0;
+    bool ordered = true;
+    while (finished.load() < producers || feed.getBacklog() > 0) {
+        changes.clear();
+        feed.drain(changes, 256);
+        for (size_t i = 0; i < changes.size(); i++) {
+            int p = changes[i].getID() / perProducer;
+            ordered = ordered && changes[i].getID() > last[p];
+            last[p] = changes[i].getID();
+        }
+        received += (int)changes.size();
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    feed.takeDropped();    // the spinning producers counted their retries
+    return ordered && received == producers * perProducer;
+}
+
+bool Tester::testRandomGenerators() {
+    const int draws = 20000;
+    Random zipf(MINID, MAXID, ZIPFIAN);
+    vector<int> hits(MAXID - MINID + 1, 0);
+    for (int i = 0; i < draws; i++) {
+        int id = zipf.getRandNum();
+        if (id < MINID || id > MAXID) {
+            return false;
+        }
+        hits[id - MINID]++;
+    }
+    // the most popular ID gets several percent of all draws
+    if (*max_element(hits.begin(), hits.end()) < draws * 3 / 100) {
+        return false;
+    }
+
+    Random burst(MINID, MAXID, SEQBURST);
+    burst.setBurstLength(16);
+    int consecutive = 0;
+    int previous = burst.getRandNum();
+    for (int i = 1; i < draws; i++) {
+        int id = burst.getRandNum();
+        if (id < MINID || id > MAXID) {
+            return false;
+        }
+        consecutive += (id == previous + 1);
+        previous = id;
+    }
+    // bursts average 8.5 numbers, so most steps continue a run
+    return consecutive > draws * 3 / 4;
+}
+
+bool Tester::testTraceRecordReplay() {
+    const string path = "satnet_test.trace";
+    Random burst(MINID, MAXID, SEQBURST);
+    Random zipf(MINID, MAXID, ZIPFIAN);
+    Random opGen(0, 9);
+
+    SatNet recorded;
+    TraceRecorder recorder;
+    if (!recorder.open(path)) {
+        return false;
+    }
+    recorded.setTracer(&recorder);
+    for (int i = 0; i < 3000; i++) {
+        recorded.insert(Sat(burst.getRandNum(), static_cast<ALT>(i % 4), static_cast<INCLIN>(i % 3), ACTIVE));
+    }
+    for (int i = 0; i < 5000; i++) {
+        int op = opGen.getRandNum();
+        if (op < 6) recorded.findSatellite(zipf.getRandNum());
+        else if (op < 8) recorded.setState(zipf.getRandNum(), DEORBITED);
+        else if (op < 9) recorded.remove(zipf.getRandNum());
+        else recorded.countSatellites(I53);
+    }
+    recorded.removeDeorbited();
+    recorded.setTracer(nullptr);
+    recorder.close();
+
+    vector<TraceRecord> records;
+    bool loaded = TraceReplayer::load(path, records);
+    std::remove(path.c_str());
+    if (!loaded || (long long)records.size() != recorder.getRecords() || records.size() != 8001) {
+        return false;
+    }
+    if (records[0].m_op != T_INSERT || records.back().m_op != T_REMOVEDEORBITED) {
+        return false;
+    }
+
+    // replaying the trace must rebuild the exact same tree
+    SatNet replayed;
+    ReplayStats stats = TraceReplayer::replay(records, replayed);
+    return stats.m_ops == 8001 && stats.m_opCount[T_INSERT] == 3000 && sameTree(recorded.m_root, replayed.m_root);
+}
+
+bool Tester::testLookupCache() {
+    SatNet network;
+    network.enableCache(64);
+    for (int i = 0; i < 1000; i++) {
+        network.insert(Sat(MINID + i));
+    }
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 1000; i += 10) {
+            if (!network.findSatellite(MINID + i)) {
+                return false;
+            }
+        }
+    }
+    if (network.getCacheHits() == 0 || network.getCacheMisses() < 100) {
+        return false;
+    }
+
+    // removing nodes with two children relinks their successors in place,
+    // every cached ID must still resolve to its own satellite
+    for (int i = 0; i < 1000; i += 3) {
+        network.remove(MINID + i);
+    }
+    for (int i = 0; i < 1000; i++) {
+        if (network.findSatellite(MINID + i) != (i % 3 != 0)) {
+            return false;
+        }
+    }
+    if (!network.setState(MINID + 1, DEORBITED) || network.setState(MINID + 3, DEORBITED)) {
+        return false;
+    }
+    network.removeDeorbited();
+    if (network.findSatellite(MINID + 1) || !network.findSatellite(MINID + 2)) {
+        return false;
+    }
+
+    // copies and clears must never hand out nodes of the old tree
+    SatNet copy;
+    copy.enableCache(16);
+    copy.findSatellite(MINID + 2);
+    copy = network;
+    network.clear();
+    if (network.findSatellite(MINID + 2) || !copy.findSatellite(MINID + 2) || !copy.setState(MINID + 2, DECAYING)) {
+        return false;
+    }
+
+    // tombstones are misses and compaction drops their entries
+    copy.setLazyRemoval(true, 0.1);
+    for (int i = 0; i < 1000; i += 2) {
+        copy.findSatellite(MINID + i);
+        copy.remove(MINID + i);
+    }
+    for (int i = 0; i < 1000; i++) {
+        if (copy.findSatellite(MINID + i) != (i % 2 == 1 && i % 3 != 0 && i != 1)) {
+            return false;
+        }
+    }
+
+    // oversized requests are clamped instead of overflowing the size
+    copy.enableCache(INT_MAX);
+    return copy.m_cache.size() == MAX_CACHE_ENTRIES && copy.findSatellite(MINID + 5) && copy.findSatellite(MINID + 5)
+           && copy.getCacheHits() == 1;
+}
+
+bool Tester::testCursorInsertAndWalk() {
+    SatNet network;
+    SatNet::Cursor cursor(network);
+
+    // a launch batch of consecutive IDs, then a second batch below the first
+    for (int id = 50000; id < 55000; id++) {
+        if (!cursor.insertAfter(Sat(id, MI215, I53))) {
+            return false;
+        }
+    }
+    for (int id = 20000; id < 21000; id++) {
+        cursor.insertAfter(Sat(id));
+    }
+    if (cursor.insertAfter(Sat(20500)) || cursor.get()->getID() != 20500) {
+        return false;   // duplicates are refused
+    }
+    bool heightsCorrect = true;
+    checkedHeight(network.m_root, heightsCorrect);
+    if (!heightsCorrect || !isTreeBalanced(network.m_root) || !isBST(network.m_root) || network.countSatellites(I53) != 5000) {
+        return false;
+    }
+
+    // a plain insert and a removal in between must not confuse the cursor
+    network.insert(Sat(30000));
+    network.remove(50001);
+    if (!cursor.seek(30000) || !cursor.next() || cursor.get()->getID() != 50000 || !cursor.next() || cursor.get()->getID() != 50002) {
+        return false;
+    }
+
+    // walking forward and back visits every satellite in order
+    int visited = 1;
+    int last = 20000;
+    if (!cursor.seek(20000)) {
+        return false;
+    }
+    while (cursor.next()) {
+        if (cursor.get()->getID() <= last) {
+            return false;
+        }
+        last = cursor.get()->getID();
+        visited++;
+    }
+    if (visited != 6000 || cursor.valid() || cursor.seek(54999) != true) {
+        return false;
+    }
+    int back = 1;
+    while (cursor.prev()) {
+        back++;
+    }
+    // seeking a missing ID lands next to where it would be
+    if (back != 6000 || cursor.seek(40000) || (cursor.get()->getID() != 30000 && cursor.get()->getID() != 50000)) {
+        return false;
+    }
+
+    // a sorted run of removals through the cursor, as the daemon batches them,
+    // keeps the tree balanced and every other satellite where it was
+    const Sat* kept = network.getHandle(50003);
+    for (int id = 50000; id < 54000; id += 2) {
+        if (cursor.seek(id) && !cursor.remove()) {
+            return false;
+        }
+        if (id % 500 == 0 && (!isTreeBalanced(network.m_root) || !isBST(network.m_root))) {
+            return false;
+        }
+    }
+    heightsCorrect = true;
+    checkedHeight(network.m_root, heightsCorrect);
+    if (!heightsCorrect || !isTreeBalanced(network.m_root) || network.size() != 6000 - 2000
+        || network.findSatellite(50002) || network.getHandle(50003) != kept) {
+        return false;
+    }
+    // the last satellite left empties the tree
+    SatNet single;
+    SatNet::Cursor only(single);
+    only.insertAfter(Sat(MINID));
+    return only.remove() && single.m_root == nullptr && !only.remove();
+}
+
+bool Tester::testStableHandles() {
+    SatNet network;
+    Random shuffler(0, 2999, SHUFFLE);
+    shuffler.setSeed(10);
+    vector<int> order;
+    shuffler.getShuffle(order);
+    for (size_t i = 0; i < order.size(); i++) {
+        network.insert(Sat(order[i], static_cast<ALT>(order[i] % 4)));
+    }
+    vector<const Sat*> handles(order.size());
+    for (int id = 0; id < 3000; id++) {
+        handles[id] = network.getHandle(id);
+    }
+    if (network.getHandle(5000) != nullptr) {
+        return false;
+    }
+
+    // remove a third in random order, the others must stay where they are
+    for (size_t i = 0; i < order.size(); i++) {
+        if (order[i] % 3 == 0) {
+            network.remove(order[i]);
+        }
+    }
+    for (int id = 0; id < 3000; id++) {
+        if (id % 3 == 0) {
+            if (network.getHandle(id) != nullptr) {
+                return false;
+            }
+        } else if (network.getHandle(id) != handles[id] || handles[id]->getID() != id || handles[id]->getAlt() != id % 4) {
+            return false;
+        }
+    }
+
+    // updates through handles need no lookup and survive more removals
+    for (int id = 1; id < 3000; id += 3) {
+        if (!network.setState(handles[id], DEORBITED)) {
+            return false;
+        }
+    }
+    network.removeDeorbited();
+    // with nothing left to remove the tree is not touched
+    long long version = network.m_version;
+    network.removeDeorbited();
+    if (network.m_version != version) {
+        return false;
+    }
+    network.setLazyRemoval(true, 0.2);
+    for (int id = 2; id < 1500; id += 3) {
+        network.remove(id);
+    }
+    network.compact();
+    for (int id = 1502; id < 3000; id += 3) {
+        if (network.getHandle(id) != handles[id] || !network.setState(handles[id], DECAYING)) {
+            return false;
+        }
+    }
+    return network.countSatellites(I48) == 500 && isTreeBalanced(network.m_root) && isBST(network.m_root)
+           && network.parallelReduce(0, [](int& n, const Sat& s) {n += (s.getState() == DECAYING);},
+                                     [](int& n, int& right) {n += right;}) == 500;
+}
+
+bool Tester::testShardedSatNet() {
+    TaskPool pool(4);
+    ShardedSatNet network(8, &pool);
+    const int perThread = 5000;
+
+    // four writers fill interleaved IDs, so every shard sees every writer
+    vector<thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.push_back(thread([&network, t] {
+            for (int i = 0; i < perThread; i++) {
+                int id = MINID + i * 4 + t;
+                network.insert(Sat(id, static_cast<ALT>(id % 4), static_cast<INCLIN>(id % 4)));
+                if (id % 5 == 0) {
+                    network.setState(id, DEORBITED);
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < writers.size(); t++) {
+        writers[t].join();
+    }
+    for (int i = 0; i < 4 * perThread; i += 97) {
+        if (!network.findSatellite(MINID + i)) {
+            return false;
+        }
+    }
+    if (network.countSatellites(I48) != perThread) {
+        return false;
+    }
+
+    // IDs outside MINID..MAXID still land in an edge shard
+    network.insert(Sat(MINID - 1));
+    network.insert(Sat(MAXID + 1));
+    if (!network.findSatellite(MINID - 1) || !network.findSatellite(MAXID + 1)) {
+        return false;
+    }
+
+    // every shard stays a balanced BST over its own ID range
+    network.removeDeorbited();
+    int total = 0;
+    for (int i = 0; i < network.getShards(); i++) {
+        const SatNet& shard = network.m_shards[i].m_network;
+        if (!isTreeBalanced(shard.m_root) || !isBST(shard.m_root)) {
+            return false;
+        }
+        vector<const Sat*> live = shard.collectSatellites([](const Sat&) {return true;});
+        for (size_t j = 0; j < live.size(); j++) {
+            if (network.shardOf(live[j]->getID()) != i || live[j]->getState() == DEORBITED) {
+                return false;
+            }
+        }
+        total += (int)live.size();
+    }
+    if (total != 4 * perThread - 4 * perThread / 5 + 2) {
+        return false;
+    }
+
+    int before = network.countSatellites(I53);
+    ShardedSatNet copy(8);
+    copy = network;
+    // a different shard count routes every satellite into the new ranges
+    ShardedSatNet routed(3, &pool);
+    routed = network;
+    for (int i = 0; i < routed.getShards(); i++) {
+        const SatNet& shard = routed.m_shards[i].m_network;
+        vector<const Sat*> live = shard.collectSatellites([](const Sat&) {return true;});
+        for (size_t j = 0; j < live.size(); j++) {
+            if (routed.shardOf(live[j]->getID()) != i) {
+                return false;
+            }
+        }
+        if (!isTreeBalanced(shard.m_root) || !isBST(shard.m_root)) {
+            return false;
+        }
+    }
+    network.clear();
+    return !network.findSatellite(MINID + 1) && copy.findSatellite(MINID + 1)
+           && network.countSatellites(I53) == 0 && copy.countSatellites(I53) == before
+           && routed.countSatellites(I53) == before && routed.findSatellite(MINID - 1) && routed.findSatellite(MAXID + 1);
+}
+
+// the bitmap must mark exactly the live in-range satellites of the tree,
+// and countRange must agree with counting them one by one
+static bool bitmapMatches(const SatNet& network, const SatBitmap& present, Random& rangeGen) {
+    vector<const Sat*> live = network.collectSatellites([](const Sat&) {return true;});
+    vector<bool> expected(MAXID - MINID + 1, false);
+    for (size_t i = 0; i < live.size(); i++) {
+        if (SatBitmap::inRange(live[i]->getID())) {
+            expected[live[i]->getID() - MINID] = true;
+        }
+    }
+    for (int id = MINID; id <= MAXID; id++) {
+        if (present.test(id) != expected[id - MINID]) {
+            return false;
+        }
+    }
+    for (int i = 0; i < 50; i++) {
+        int low = rangeGen.getRandNum();
+        int high = low + rangeGen.getRandNum() % 30000;
+        int brute = 0;
+        for (size_t j = 0; j < live.size(); j++) {
+            brute += (live[j]->getID() >= low && live[j]->getID() <= high);
+        }
+        if (network.countRange(low, high) != brute) {
+            return false;
+        }
+    }
+    return network.size() == (int)live.size();
+}
+
+bool Tester::testPresenceBitmap() {
+    Random idGen(MINID - 500, MAXID + 500);     // a few IDs fall outside the bitmap
+    Random rangeGen(MINID - 1000, MAXID);
+    SatNet network;
+    for (int i = 0; i < 20000; i++) {
+        int id = idGen.getRandNum();
+        network.insert(Sat(id, MI208, I48, (id % 7 == 0) ? DEORBITED : ACTIVE));
+    }
+    for (int i = 0; i < 5000; i++) {
+        network.remove(idGen.getRandNum());
+    }
+    if (!bitmapMatches(network, network.m_present, rangeGen)) {
+        return false;
+    }
+
+    // misses answer false everywhere a lookup is made
+    int missing = MINID;
+    while (network.getHandle(missing) != nullptr) {
+        missing++;
+    }
+    if (network.findSatellite(missing) || network.setState(missing, DECAYING) || network.getHandle(missing) != nullptr) {
+        return false;
+    }
+
+    network.removeDeorbited();
+    SatNet::Cursor cursor(network);
+    for (int id = MAXID - 300; id <= MAXID + 300; id++) {
+        cursor.insertAfter(Sat(id));
+    }
+    if (!bitmapMatches(network, network.m_present, rangeGen)) {
+        return false;
+    }
+
+    // tombstones clear their bit, reviving and compacting keep it right
+    network.setLazyRemoval(true, 0.5);
+    for (int i = 0; i < 3000; i++) {
+        network.remove(idGen.getRandNum());
+    }
+    for (int i = 0; i < 1000; i++) {
+        network.insert(Sat(idGen.getRandNum()));
+    }
+    if (network.getTombstones() == 0 || !bitmapMatches(network, network.m_present, rangeGen)) {
+        return false;
+    }
+    network.removeDeorbited();
+    SatNet copy;
+    copy = network;
+    network.compact();
+    if (!bitmapMatches(network, network.m_present, rangeGen) || !bitmapMatches(copy, copy.m_present, rangeGen)) {
+        return false;
+    }
+
+    vector<Sat> sorted;
+    for (int id = MINID; id <= MAXID; id += 3) {
+        sorted.push_back(Sat(id));
+    }
+    copy.buildFromSorted(sorted);
+    network.clear();
+    return bitmapMatches(copy, copy.m_present, rangeGen) && bitmapMatches(network, network.m_present, rangeGen)
+           && copy.countRange(MINID, MAXID) == (int)sorted.size() && network.size() == 0 && !network.findSatellite(MINID);
+}
+
+bool Tester::testStateHistory() {
+    const int satellites = 300;
+    Random countGen(0, 400);
+    Random deltaGen(0, 5000);
+    Random stateGen(0, 2);
+    StateHistory history;
+
+    // a plain list of transitions per satellite is the reference
+    vector<vector<pair<long long, STATE>>> expected(satellites);
+    long long total = 0;
+    for (int s = 0; s < satellites; s++) {
+        long long time = deltaGen.getRandNum() * 1000LL;
+        int transitions = (s % 10 == 0) ? 0 : countGen.getRandNum();
+        for (int i = 0; i < transitions; i++) {
+            time += (i % 50 == 7) ? 0 : deltaGen.getRandNum();  // some share a timestamp
+            STATE state = static_cast<STATE>(stateGen.getRandNum());
+            history.append(MINID + s, time, state);
+            expected[s].push_back(make_pair(time, state));
+            total++;
+        }
+    }
+    if (history.getTransitions() != total || (double)history.getBytes() / total > 6) {
+        return false;
+    }
+
+    Random timeGen(0, 3000000);
+    for (int q = 0; q < 3000; q++) {
+        int s = q % satellites;
+        long long time = timeGen.getRandNum();
+        STATE state = ACTIVE;
+        bool known = history.stateAt(MINID + s, time, state);
+        int last = -1;
+        for (size_t i = 0; i < expected[s].size() && expected[s][i].first <= time; i++) {
+            last = (int)i;
+        }
+        if (known != (last >= 0) || (known && state != expected[s][last].second)) {
+            return false;
+        }
+
+        long long to = time + timeGen.getRandNum() / 10;
+        vector<pair<long long, STATE>> window = history.transitions(MINID + s, time, to);
+        vector<pair<long long, STATE>> brute;
+        for (size_t i = 0; i < expected[s].size(); i++) {
+            if (expected[s][i].first >= time && expected[s][i].first <= to) {
+                brute.push_back(expected[s][i]);
+            }
+        }
+        if (window != brute) {
+            return false;
+        }
+    }
+
+    for (int q = 0; q < 20; q++) {
+        long long from = timeGen.getRandNum();
+        long long to = from + timeGen.getRandNum() / 20;
+        int brute = 0;
+        for (int s = 0; s < satellites; s++) {
+            bool found = false;
+            for (size_t i = 0; i < expected[s].size() && expected[s][i].first <= to; i++) {
+                bool nextBeforeWindow = i + 1 < expected[s].size() && expected[s][i + 1].first <= from;
+                found = found || (expected[s][i].second == DECAYING && !nextBeforeWindow);
+            }
+            brute += found;
+        }
+        if (history.countInState(DECAYING, from, to) != brute) {
+            return false;
+        }
+    }
+
+    // the scheduler records transitions at their scheduled times
+    SatNet network;
+    for (int id = MINID; id < MINID + 10; id++) {
+        network.insert(Sat(id));
+    }
+    StateHistory recorded;
+    DecayScheduler scheduler(network);
+    scheduler.setHistory(&recorded);
+    scheduler.schedule(MINID, 100, DECAYING);
+    scheduler.schedule(MINID, 300, DEORBITED);
+    scheduler.schedule(MINID + 1, 200, DECAYING);
+    scheduler.schedule(MAXID, 150, DECAYING);   // not in the network
+    scheduler.advanceTo(1000);
+    STATE state = ACTIVE;
+    return recorded.getTransitions() == 3 && recorded.stateAt(MINID, 250, state) && state == DECAYING
+           && !recorded.stateAt(MINID + 1, 199, state) && recorded.countInState(DEORBITED, 0, 1000) == 1
+           && recorded.transitions(MINID, 0, 1000).size() == 2;
+}
+
+bool Tester::testOrbitPropagation() {
+    Random angleGen(0, 62831);
+    SatNet network;
+    OrbitCatalog catalog;
+    for (int id = MINID; id < MINID + 1001; id++) {
+        network.insert(Sat(id, static_cast<ALT>(id % 4), static_cast<INCLIN>((id / 4) % 4), (id % 50 == 0) ? DEORBITED : ACTIVE));
+        catalog.setElements(id, angleGen.getRandNum() / 10000.0f, angleGen.getRandNum() / 10000.0f);
+    }
+    // elements are looked up by ID on every load, and dropped ones start at 0
+    catalog.setElements(MINID + 3, 1.5f, 2.5f);
+    catalog.setElements(MINID + 4, 1.5f, 2.5f);
+    catalog.eraseElements(MINID + 4);
+    catalog.load(network);
+    if (catalog.size() != 1001 - 21 || catalog.getID(0) != MINID + 1 || catalog.getID(catalog.size() - 1) != MINID + 999
+        || catalog.getID(2) != MINID + 3 || catalog.m_raan[2] != 1.5f || catalog.m_anomaly[2] != 2.5f
+        || catalog.m_raan[3] != 0 || catalog.m_anomaly[3] != 0) {
+        return false;
+    }
+    TaskPool pool(4);
+    const double times[4] = {0, 5400, 86400 * 3.5, 3.0e7};
+    for (int t = 0; t < 4; t++) {
+        catalog.propagateScalar(times[t]);
+        vector<float> x(catalog.getX(), catalog.getX() + catalog.size());
+        vector<float> y(catalog.getY(), catalog.getY() + catalog.size());
+        vector<float> z(catalog.getZ(), catalog.getZ() + catalog.size());
+        catalog.propagate(times[t], (t % 2) ? &pool : nullptr);
+        for (int i = 0; i < catalog.size(); i++) {
+            // within 10 m of the double precision reference, and on the orbit's sphere
+            double error = fabs(catalog.getX()[i] - x[i]) + fabs(catalog.getY()[i] - y[i]) + fabs(catalog.getZ()[i] - z[i]);
+            double radius = sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+            if (error > 0.01 || fabs(radius - catalog.m_radius[i]) > 0.01) {
+                return false;
+            }
+        }
+    }
+
+    // a satellite with node and anomaly 0 starts at (r, 0, 0) and a quarter
+    // orbit later sits at the top of its inclined plane
+    SatNet single;
+    single.insert(Sat(MINID, MI340, I53));
+    catalog.eraseElements(MINID);
+    catalog.load(single);
+    catalog.propagate(0);
+    double radius = catalog.m_radius[0];
+    if (fabs(catalog.getX()[0] - radius) > 0.01 || fabs(catalog.getY()[0]) > 0.01 || fabs(catalog.getZ()[0]) > 0.01) {
+        return false;
+    }
+    double quarter = ((2 * M_PI) / 4) / catalog.m_motion[0];
+    catalog.propagate(quarter);
+    return fabs(catalog.getZ()[0] - radius * sin(53 * (2 * M_PI) / 360)) < 0.05;
+}
+
+bool Tester::testConjunctionScreen() {
+    Random angleGen(0, 62831);
+    SatNet network;
+    OrbitCatalog catalog;
+    for (int id = MINID; id < MINID + 4000; id++) {
+        network.insert(Sat(id, static_cast<ALT>(id % 4), static_cast<INCLIN>((id / 4) % 4), ACTIVE));
+        catalog.setElements(id, angleGen.getRandNum() / 10000.0f, angleGen.getRandNum() / 10000.0f);
+    }
+    // two satellites sharing an orbit a few kilometers apart must always be reported
+    network.insert(Sat(MAXID - 1, MI340, I70, ACTIVE));
+    network.insert(Sat(MAXID, MI340, I70, ACTIVE));
+    catalog.setElements(MAXID - 1, 1.0f, 2.0f);
+    catalog.setElements(MAXID, 1.0f, 2.0005f);
+    catalog.load(network);
+
+    TaskPool pool(4);
+    ConjunctionScreen screen(&pool);
+    // below 11 km every shell is on its own, at 20 km the two low and the
+    // two high shells share a grid, at 250 km everything does
+    const float thresholds[4] = {5, 20, 100, 250};
+    const int groups[4] = {4, 2, 2, 1};
+    const double times[2] = {0, 4000};
+    for (int t = 0; t < 2; t++) {
+        catalog.propagate(times[t]);
+        for (int k = 0; k < 4; k++) {
+            vector<Conjunction> fast = screen.screen(catalog, thresholds[k]);
+            vector<Conjunction> brute = ConjunctionScreen::bruteForce(catalog, thresholds[k]);
+            if (screen.getGroups() != groups[k] || fast.size() != brute.size() || fast.empty()) {
+                return false;
+            }
+            for (size_t i = 0; i < fast.size(); i++) {
+                if (fast[i].m_first != brute[i].m_first || fast[i].m_second != brute[i].m_second
+                    || fast[i].m_distance != brute[i].m_distance || fast[i].m_distance > thresholds[k]) {
+                    return false;
+                }
+            }
+            // the grid only looks at a small part of the pairs
+            long long pairs = (long long)catalog.size() * (catalog.size() - 1) / 2;
+            if (thresholds[k] < 100 && screen.getCandidates() * 20 > pairs) {
+                return false;
+            }
+        }
+    }
+    vector<Conjunction> close = screen.screen(catalog, 5);
+    return binary_search(close.begin(), close.end(), Conjunction(MAXID - 1, MAXID));
+}
+
+bool Tester::testBalancePolicy() {
+    // launches in ID order rotate the most, every policy fixes an insert
+    // with at most two rotations and keeps the height logarithmic
+    const int count = 5000;
+    SatNet network;
+    for (int id = MINID; id < MINID + count; id++) {
+        network.insert(Sat(id));
+    }
+    bool correct = true;
+    int height = checkedHeight(network.m_root, correct);
+    if (!correct || !isTreeBalanced(network.m_root) || network.getRotations() == 0
+        || network.getRotations() > 2 * count || height > 2 * log2(count + 1)) {
+        return false;
+    }
+
+    // decays and launches at random, through both insert paths
+    Random idGen(MINID, MINID + 2 * count);
+    SatNet::Cursor cursor(network);
+    for (int i = 0; i < 4 * count; i++) {
+        int id = idGen.getRandNum();
+        if (i % 3 == 0) {
+            network.remove(id);
+        } else if (i % 3 == 1) {
+            network.insert(Sat(id));
+        } else {
+            cursor.insertAfter(Sat(id));
+        }
+        if (i % 1000 == 0 && (!isTreeBalanced(network.m_root) || !isBST(network.m_root))) {
+            return false;
+        }
+    }
+    correct = true;
+    checkedHeight(network.m_root, correct);
+    if (!correct || !isTreeBalanced(network.m_root)) {
+        return false;
+    }
+    for (int id = MINID; id <= MINID + 2 * count; id++) {
+        network.remove(id);
+    }
+    return network.m_root == nullptr && network.size() == 0;
+}
+
+bool Tester::testEnumMetadata() {
+    // the tables are usable at compile time
+    static_assert(ALT_MILES[MI340] == 340 && INCLIN_DEGREES[I97] == 97, "enum values");
+    static_assert(STATE_NAMES[DECAYING] == "Decaying" && ALT_NAMES[MI208] == "208 miles", "enum names");
+    Sat satellite(MINID, MI215, I70, DEORBITED);
+    if (satellite.getStateStr() != "Deorbited" || satellite.getInclinStr() != "70 degrees" || satellite.getAltStr() != "215 miles"
+        || satellite.getAltMiles() != 215 || satellite.getInclinDegrees() != 70
+        || !satellite.is<DEORBITED>() || satellite.is<ACTIVE>() || !satellite.is<MI215>() || !satellite.is<I70>()) {
+        return false;
+    }
+    // a state outside the enum is named, never read past the table
+    satellite.setState(static_cast<STATE>(3));
+    if (satellite.getStateStr() != "UNKNOWN") {
+        return false;
+    }
+
+    SatNet network;
+    int states[3] = {0, 0, 0};
+    int alts[4] = {0, 0, 0, 0};
+    int inclins[4] = {0, 0, 0, 0};
+    for (int id = MINID; id < MINID + 1000; id++) {
+        Sat sat(id, static_cast<ALT>(id % 4), static_cast<INCLIN>(id / 4 % 4), static_cast<STATE>(id % 3));
+        network.insert(sat);
+        states[sat.getState()]++;
+        alts[sat.getAlt()]++;
+        inclins[sat.getInclin()]++;
+    }
+    return network.count<ACTIVE>() == states[ACTIVE] && network.count<DEORBITED>() == states[DEORBITED]
+           && network.count<DECAYING>() == states[DECAYING] && network.count<MI208>() == alts[MI208]
+           && network.count<MI350>() == alts[MI350] && network.count<I53>() == inclins[I53]
+           && network.countSatellites(I53) == inclins[I53] && network.countSatellites(I97) == inclins[I97];
+}
+
+bool Tester::testTraceCopyAndBuild() {
+    const string path = "satnet_copy.trace";
+    Random idGen(MINID, MAXID);
+    // a source shaped by random inserts and lazy removals, so a midpoint
+    // rebuild would not reproduce it
+    SatNet source;
+    source.setLazyRemoval(true);
+    for (int i = 0; i < 2000; i++) {
+        source.insert(Sat(idGen.getRandNum(), static_cast<ALT>(i % 4), static_cast<INCLIN>(i % 3), static_cast<STATE>(i % 3)));
+    }
+    for (int i = 0; i < 100; i++) {
+        source.remove(idGen.getRandNum());
+    }
+    vector<Sat> sorted;
+    for (int id = MINID; id < MINID + 3000; id += 2) {
+        sorted.push_back(Sat(id, MI340, I97, DECAYING));
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        SatNet recorded;
+        recorded.setLazyRemoval(true);
+        TraceRecorder recorder;
+        if (!recorder.open(path)) {
+            return false;
+        }
+        recorded.setTracer(&recorder);
+        recorded.insert(Sat(MINID));
+        if (pass == 0) {
+            recorded = source;
+        } else {
+            recorded.buildFromSorted(sorted);
+        }
+        for (int i = 0; i < 200; i++) {
+            recorded.insert(Sat(idGen.getRandNum()));
+            recorded.setState(idGen.getRandNum(), DEORBITED);
+        }
+        recorded.setTracer(nullptr);
+        recorder.close();
+
+        vector<TraceRecord> records;
+        bool loaded = TraceReplayer::load(path, records);
+        std::remove(path.c_str());
+        SatNet replayed;
+        replayed.setLazyRemoval(true);
+        ReplayStats stats = TraceReplayer::replay(records, replayed);
+        if (!loaded || stats.m_opCount[T_SNAPSHOT] != 1 || !sameTree(recorded.m_root, replayed.m_root)
+            || replayed.size() != recorded.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// runs the same operation mix against an AVL SatNet and a BPSatNet
+template <class Net>
+double runMix(Net& net, const vector<int>& ops, const vector<int>& ids) {
+    clock_t start = clock();
+    int found = 0;
+    for (size_t i = 0; i < ops.size(); i++) {
+        switch (ops[i]) {
+            case 0: found += net.findSatellite(ids[i]); break;
+            case 1: net.setState(ids[i], DECAYING); break;
+            case 2: net.insert(Sat(ids[i])); break;
+            default: net.remove(ids[i]); break;
+        }
+    }
+    double seconds = static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+    if (found < 0) cout << found; // keep the lookups from being optimized away
+    return seconds;
+}
+
+void Tester::benchBPTreeVsAVL() {
+    Random idGen(MINID, MAXID);
+    Random opGen(0, 99);
+    const int treeSize = 60000;
+    const int numOps = 1000000;
+
+    cout << "B+-tree (" << BPT_NODE_BYTES << " byte nodes) vs AVL, " << treeSize << " satellites, "
+         << numOps << " ops" << endl;
+
+    // read heavy: 90% find, 5% setState, 5% insert/remove
+    // write heavy: 40% find, 10% setState, 50% insert/remove
+    const int mixes[2][3] = {{90, 95, 97}, {40, 50, 75}};
+    const char* names[2] = {"read-heavy ", "write-heavy"};
+
+    for (int m = 0; m < 2; m++) {
+        SatNet avl;
+        BPSatNet bpt;
+        for (int i = 0; i < treeSize; i++) {
+            int id = idGen.getRandNum();
+            avl.insert(Sat(id));
+            bpt.insert(Sat(id));
+        }
+        vector<int> ops(numOps);
+        vector<int> ids(numOps);
+        for (int i = 0; i < numOps; i++) {
+            int r = opGen.getRandNum();
+            ops[i] = (r < mixes[m][0]) ? 0 : (r < mixes[m][1]) ? 1 : (r < mixes[m][2]) ? 2 : 3;
+            ids[i] = idGen.getRandNum();
+        }
+        double tAvl = runMix(avl, ops, ids);
+        double tBpt = runMix(bpt, ops, ids);
+        cout << names[m] << "  AVL: " << numOps / tAvl / 1e6 << " Mops/s   B+-tree: "
+             << numOps / tBpt / 1e6 << " Mops/s   speedup: " << tAvl / tBpt << endl;
+    }
+}
+
+void Tester::benchParallelBuildCopyClear() {
+    const int netSize = 1000000;
+    int cores = (int)thread::hardware_concurrency();
+    vector<Sat> sorted;
+    for (int i = 0; i < netSize; i++) {
+        sorted.push_back(Sat(i, static_cast<ALT>(i % 4), static_cast<INCLIN>(i % 4)));
+    }
+
+    cout << "Parallel build/copy/clear, " << netSize << " satellites" << endl;
+    cout << "threads    build(s)    copy(s)    clear(s)    copy speedup" << endl;
+    double baseCopy = 0;
+    for (int threads = 1; threads <= cores; threads *= 2) {
+        TaskPool pool(threads);
+        SatNet source;
+        SatNet target;
+        source.setTaskPool(&pool);
+        target.setTaskPool(&pool);
+
+        auto start = chrono::steady_clock::now();
+        source.buildFromSorted(sorted);
+        auto built = chrono::steady_clock::now();
+        target = source;
+        auto copied = chrono::steady_clock::now();
+        target.clear();
+        auto cleared = chrono::steady_clock::now();
+
+        double tBuild = chrono::duration<double>(built - start).count();
+        double tCopy = chrono::duration<double>(copied - built).count();
+        double tClear = chrono::duration<double>(cleared - copied).count();
+        if (threads == 1) {
+            baseCopy = tCopy;
+        }
+        cout << threads << "          " << tBuild << "    " << tCopy << "    " << tClear << "    " << baseCopy / tCopy << endl;
+        if (threads < cores && threads * 2 > cores) {
+            threads = cores / 2;    // make sure the last row uses every core
+        }
+    }
+}
+
+void Tester::benchParallelReduce() {
+    const int netSize = 1000000;
+    const int rounds = 10;
+    int cores = (int)thread::hardware_concurrency();
+    vector<Sat> sorted;
+    for (int i = 0; i < netSize; i++) {
+        sorted.push_back(Sat(i, static_cast<ALT>((i / 3) % 4), static_cast<INCLIN>(i % 4), (i % 9 == 0) ? DECAYING : ACTIVE));
+    }
+
+    cout << "Parallel reduce, " << netSize << " satellites, " << rounds << " rounds each" << endl;
+    cout << "threads    count(s)    histogram(s)    collect(s)    steals" << endl;
+    for (int threads = 1; threads <= cores; threads *= 2) {
+        TaskPool pool(threads);
+        SatNet network;
+        network.setTaskPool(&pool);
+        network.buildFromSorted(sorted);
+
+        long check = 0;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            check += network.countSatellites(I53);
+        }
+        auto counted = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            vector<int> hist = network.parallelReduce(vector<int>(16, 0),
+                [](vector<int>& h, const Sat& s) {h[s.getAlt() * 4 + s.getState()]++;},
+                [](vector<int>& h, vector<int>& right) {for (int i = 0; i < 16; i++) h[i] += right[i];});
+            check += hist[0];
+        }
+        auto histogrammed = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            check += network.collectSatellites([](const Sat& s) {return s.getState() == DECAYING;}).size();
+        }
+        auto collected = chrono::steady_clock::now();
+
+        cout << threads << "          " << chrono::duration<double>(counted - start).count()
+             << "    " << chrono::duration<double>(histogrammed - counted).count()
+             << "    " << chrono::duration<double>(collected - histogrammed).count()
+             << "    " << pool.getSteals() << (check < 0 ? "!" : "") << endl;
+        if (threads < cores && threads * 2 > cores) {
+            threads = cores / 2;    // make sure the last row uses every core
+        }
+    }
+}
+
+void Tester::benchLazyRemoval() {
+    Random shuffler(MINID, MAXID, SHUFFLE);
+    shuffler.setSeed(10);
+    vector<int> ids;
+    shuffler.getShuffle(ids);
+    const int removals = (int)ids.size() / 2;
+
+    cout << "Eager vs lazy removal, " << ids.size() << " satellites, " << removals << " removals" << endl;
+    for (int lazy = 0; lazy <= 1; lazy++) {
+        SatNet network;
+        for (size_t i = 0; i < ids.size(); i++) {
+            network.insert(Sat(ids[i]));
+        }
+        network.setLazyRemoval(lazy == 1);
+
+        vector<double> latency(removals);
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < removals; i++) {
+            auto before = chrono::steady_clock::now();
+            network.remove(ids[i]);
+            latency[i] = chrono::duration<double, micro>(chrono::steady_clock::now() - before).count();
+        }
+        double total = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        sort(latency.begin(), latency.end());
+        cout << (lazy ? "lazy " : "eager") << "  throughput: " << removals / total / 1e6 << " Mops/s"
+             << "   p50: " << latency[removals / 2] << "us   p99: " << latency[removals * 99 / 100]
+             << "us   max: " << latency[removals - 1] << "us" << endl;
+    }
+}
+
+void Tester::benchDecayScheduler() {
+    const int numEvents = 2000000;
+    const long long horizon = 30LL * 24 * 3600;     // a month of seconds
+    Random timeGen(0, (int)horizon);
+    Random idGen(MINID, MAXID);
+
+    SatNet network;
+    for (int id = MINID; id <= MAXID; id++) {
+        network.insert(Sat(id));
+    }
+    DecayScheduler scheduler(network);
+    vector<int> ids(numEvents);
+    vector<long long> times(numEvents);
+    for (int i = 0; i < numEvents; i++) {
+        ids[i] = idGen.getRandNum();
+        times[i] = timeGen.getRandNum();
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < numEvents; i++) {
+        scheduler.schedule(ids[i], times[i], (i % 2 == 0) ? DECAYING : ACTIVE);
+    }
+    auto scheduled = chrono::steady_clock::now();
+    long long applied = 0;
+    for (long long t = 3600; t <= horizon; t += 3600) {
+        applied += scheduler.advanceTo(t);
+    }
+    auto advanced = chrono::steady_clock::now();
+
+    double tSchedule = chrono::duration<double>(scheduled - start).count();
+    double tAdvance = chrono::duration<double>(advanced - scheduled).count();
+    cout << "Decay scheduler, " << numEvents << " events over " << horizon << " ticks, hourly advances" << endl;
+    cout << "schedule: " << tSchedule * 1e9 / numEvents << " ns/event   advance+apply: "
+         << tAdvance * 1e9 / numEvents << " ns/event   applied: " << applied << endl;
+}
+
+void Tester::benchTraceReplay(const string& path) {
+    const int launches = 60000;
+    const int numOps = 1000000;
+    Random burst(MINID, MAXID, SEQBURST);
+    Random zipf(MINID, MAXID, ZIPFIAN);
+    Random opGen(0, 99);
+
+    // synthesize: launch bursts, then a Zipf skewed mix of reads and updates
+    {
+        SatNet network;
+        TraceRecorder recorder;
+        if (!recorder.open(path)) {
+            cout << "cannot write " << path << endl;
+            return;
+        }
+        network.setTracer(&recorder);
+        for (int i = 0; i < launches; i++) {
+            network.insert(Sat(burst.getRandNum(), static_cast<ALT>(i % 4), static_cast<INCLIN>(i % 4)));
+        }
+        for (int i = 0; i < numOps; i++) {
+            int op = opGen.getRandNum();
+            if (op < 70) network.findSatellite(zipf.getRandNum());
+            else if (op < 90) network.setState(zipf.getRandNum(), (i % 7 == 0) ? DEORBITED : DECAYING);
+            else if (op < 95) network.insert(Sat(burst.getRandNum()));
+            else if (op < 99) network.remove(zipf.getRandNum());
+            else network.countSatellites(static_cast<INCLIN>(i % 4));
+        }
+        network.setTracer(nullptr);
+        recorder.close();
+        ifstream size(path, ios::binary | ios::ate);
+        cout << "Trace replay, wrote " << recorder.getRecords() << " calls to " << path << " ("
+             << (double)size.tellg() / recorder.getRecords() << " bytes/call)" << endl;
+    }
+
+    vector<TraceRecord> records;
+    if (!TraceReplayer::load(path, records)) {
+        cout << "cannot read " << path << endl;
+        return;
+    }
+    SatNet network;
+    ReplayStats stats = TraceReplayer::replay(records, network);
+    cout << "full speed: " << stats.m_ops / stats.m_seconds / 1e6 << " Mcalls/s   p50: " << stats.percentile(50)
+         << "us   p99: " << stats.percentile(99) << "us   p99.9: " << stats.percentile(99.9)
+         << "us   max: " << stats.percentile(100) << "us" << endl;
+}
+
+void Tester::benchLookupCache() {
+    const int numOps = 2000000;
+    Random zipf(MINID, MAXID, ZIPFIAN);
+    vector<int> ids(numOps);
+    for (int i = 0; i < numOps; i++) {
+        ids[i] = zipf.getRandNum();
+    }
+
+    cout << "Hot-ID cache, " << (MAXID - MINID + 1) << " satellites, " << numOps << " Zipf find/setState calls" << endl;
+    const int sizes[4] = {0, 256, 1024, 4096};
+    for (int s = 0; s < 4; s++) {
+        SatNet network;
+        for (int id = MINID; id <= MAXID; id++) {
+            network.insert(Sat(id));
+        }
+        network.enableCache(sizes[s]);
+        long long found = 0;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < numOps; i++) {
+            if (i % 4 == 0) {
+                found += network.setState(ids[i], DECAYING);
+            } else {
+                found += network.findSatellite(ids[i]);
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        long long lookups = network.getCacheHits() + network.getCacheMisses();
+        cout << "entries: " << sizes[s] << "   " << numOps / seconds / 1e6 << " Mops/s   hit rate: "
+             << (lookups > 0 ? 100.0 * network.getCacheHits() / lookups : 0.0) << "%" << (found < 0 ? "!" : "") << endl;
+    }
+}
+
+void Tester::benchCursorInsert() {
+    const int baseSize = 40000;
+    const int runs[4] = {1000, 5000, 20000, 50000};
+    Random idGen(0, 4000000);
+
+    cout << "Ascending launch runs into a " << baseSize << " satellite tree" << endl;
+    cout << "run length    insert(ns/op)    cursor(ns/op)    speedup" << endl;
+    for (int r = 0; r < 4; r++) {
+        vector<int> base(baseSize);
+        for (int i = 0; i < baseSize; i++) {
+            base[i] = idGen.getRandNum();
+        }
+        int first = 4000001 + r * 100000;   // a fresh range past the base IDs
+
+        double times[2];
+        for (int useCursor = 0; useCursor <= 1; useCursor++) {
+            SatNet network;
+            for (int i = 0; i < baseSize; i++) {
+                network.insert(Sat(base[i]));
+            }
+            SatNet::Cursor cursor(network);
+            auto start = chrono::steady_clock::now();
+            for (int id = first; id < first + runs[r]; id++) {
+                if (useCursor) {
+                    cursor.insertAfter(Sat(id));
+                } else {
+                    network.insert(Sat(id));
+                }
+            }
+            times[useCursor] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / runs[r];
+        }
+        cout << runs[r] << "          " << times[0] << "          " << times[1] << "          " << times[0] / times[1] << endl;
+    }
+}
+
+void Tester::benchHandleUpdates() {
+    const int rounds = 20;
+    SatNet network;
+    for (int id = MINID; id <= MAXID; id++) {
+        network.insert(Sat(id));
+    }
+    vector<const Sat*> handles;
+    for (int id = MINID; id <= MAXID; id++) {
+        handles.push_back(network.getHandle(id));
+    }
+    Random shuffler(0, MAXID - MINID, SHUFFLE);
+    shuffler.setSeed(10);
+    vector<int> order;
+    shuffler.getShuffle(order);
+
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < order.size(); i++) {
+            network.setState(MINID + order[i], (r % 2) ? ACTIVE : DECAYING);
+        }
+    }
+    auto byID = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < order.size(); i++) {
+            network.setState(handles[order[i]], (r % 2) ? ACTIVE : DECAYING);
+        }
+    }
+    auto byHandle = chrono::steady_clock::now();
+
+    double updates = (double)rounds * order.size();
+    cout << "Telemetry setState, " << order.size() << " satellites in random order" << endl;
+    cout << "by ID: " << chrono::duration<double, nano>(byID - start).count() / updates << " ns/update   by handle: "
+         << chrono::duration<double, nano>(byHandle - byID).count() / updates << " ns/update" << endl;
+}
+
+void Tester::benchShardedScaling() {
+    const int opsPerThread = 400000;
+    const int shardCounts[4] = {1, 4, 16, 64};
+    int cores = (int)thread::hardware_concurrency();
+    int maxThreads = (cores < 4) ? 4 : cores;   // rows past the core count are oversubscribed
+
+    cout << "Sharded SatNet, " << (MAXID - MINID + 1) << " satellites, 80% find 10% setState 5% insert 5% remove, "
+         << cores << " cores" << endl;
+    cout << "threads    shards    Mops/s" << endl;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        for (int s = 0; s < 4; s++) {
+            ShardedSatNet network(shardCounts[s]);
+            for (int id = MINID; id <= MAXID; id++) {
+                network.insert(Sat(id));
+            }
+            vector<thread> workers;
+            auto start = chrono::steady_clock::now();
+            for (int t = 0; t < threads; t++) {
+                workers.push_back(thread([&network, t] {
+                    Random idGen(MINID, MAXID);
+                    Random opGen(0, 99);
+                    idGen.setSeed(t + 1);
+                    opGen.setSeed(t + 101);
+                    long long found = 0;
+                    for (int i = 0; i < opsPerThread; i++) {
+                        int op = opGen.getRandNum();
+                        int id = idGen.getRandNum();
+                        if (op < 80) found += network.findSatellite(id);
+                        else if (op < 90) found += network.setState(id, DECAYING);
+                        else if (op < 95) network.insert(Sat(id));
+                        else network.remove(id);
+                    }
+                    if (found < 0) {
+                        cout << found;
+                    }
+                }));
+            }
+            for (int t = 0; t < threads; t++) {
+                workers[t].join();
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cout << threads << "          " << shardCounts[s] << "        " << (double)threads * opsPerThread / seconds / 1e6 << endl;
+        }
+        if (threads < maxThreads && threads * 2 > maxThreads) {
+            threads = maxThreads / 2;   // make sure the last row uses every core
+        }
+    }
+}
+
+void Tester::benchPresenceBitmap() {
+    const int numOps = 4000000;
+    Random idGen(MINID, MAXID);
+    SatNet network;
+    for (int id = MINID; id <= MAXID; id += 2) {
+        network.insert(Sat(id));     // every odd ID is a miss
+    }
+    vector<int> misses(numOps);
+    for (int i = 0; i < numOps; i++) {
+        misses[i] = idGen.getRandNum() | 1;
+    }
+
+    long long found = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < numOps; i++) {
+        found += network.findSatelliteHelper(network.m_root, misses[i]);
+    }
+    auto descended = chrono::steady_clock::now();
+    for (int i = 0; i < numOps; i++) {
+        found += network.findSatellite(misses[i]);
+    }
+    auto filtered = chrono::steady_clock::now();
+    double tTree = chrono::duration<double, nano>(descended - start).count() / numOps;
+    double tBitmap = chrono::duration<double, nano>(filtered - descended).count() / numOps;
+    cout << "Negative findSatellite, " << network.size() << " satellites" << endl;
+    cout << "tree descent: " << tTree << " ns/op   bitmap: " << tBitmap << " ns/op   speedup: " << tTree / tBitmap
+         << (found != 0 ? "!" : "") << endl;
+
+    const int numRanges = 20000;
+    long long total = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < numRanges; i++) {
+        int low = idGen.getRandNum();
+        total += network.countRange(low, low + 10000);
+    }
+    double tRange = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / numRanges;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < numRanges / 100; i++) {
+        int low = idGen.getRandNum();
+        total += network.parallelReduce(0, [low](int& n, const Sat& s) {n += (s.getID() >= low && s.getID() <= low + 10000);},
+                                        [](int& n, int& right) {n += right;});
+    }
+    double tScan = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (numRanges / 100);
+    cout << "10000 ID countRange: " << tRange << " ns   full scan: " << tScan << " ns" << (total < 0 ? "!" : "") << endl;
+}
+
+void Tester::benchStateHistory() {
+    const int perSatellite = 100;
+    const int satellites = MAXID - MINID + 1;
+    Random deltaGen(60, 86400);     // one transition every minute to every day, in seconds
+    Random stateGen(0, 2);
+    Random idGen(MINID, MAXID);
+    StateHistory history;
+
+    vector<long long> clock(satellites, 0);
+    auto start = chrono::steady_clock::now();
+    for (int round = 0; round < perSatellite; round++) {
+        for (int s = 0; s < satellites; s++) {
+            clock[s] += deltaGen.getRandNum();
+            history.append(MINID + s, clock[s], static_cast<STATE>(stateGen.getRandNum()));
+        }
+    }
+    double tAppend = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / history.getTransitions();
+    cout << "State history, " << satellites << " satellites x " << perSatellite << " transitions" << endl;
+    cout << "bytes/transition: " << (double)history.getBytes() / history.getTransitions()
+         << " (" << sizeof(pair<long long, STATE>) << " uncompressed)   append: " << tAppend << " ns" << endl;
+
+    const int numQueries = 1000000;
+    long long horizon = 43200LL * perSatellite;
+    Random timeGen(0, (int)horizon);
+    long long sink = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < numQueries; i++) {
+        STATE state = ACTIVE;
+        sink += history.stateAt(idGen.getRandNum(), timeGen.getRandNum(), state) + state;
+    }
+    double tPoint = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / numQueries;
+    start = chrono::steady_clock::now();
+    long long week = 7 * 86400LL;
+    int decaying = history.countInState(DECAYING, horizon / 2, horizon / 2 + week);
+    double tCount = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "stateAt: " << tPoint << " ns   countInState over a week: " << tCount << " ms (" << decaying
+         << " satellites)" << (sink < 0 ? "!" : "") << endl;
+}
+
+void Tester::benchOrbitPropagation() {
+    const int steps = 200;
+    Random angleGen(0, 62831);
+    vector<Sat> sorted;
+    OrbitCatalog catalog;
+    for (int id = MINID; id <= MAXID; id++) {
+        sorted.push_back(Sat(id, static_cast<ALT>(id % 4), static_cast<INCLIN>((id / 4) % 4), ACTIVE));
+        catalog.setElements(id, angleGen.getRandNum() / 10000.0f, angleGen.getRandNum() / 10000.0f);
+    }
+    SatNet network;
+    network.buildFromSorted(sorted);
+    catalog.load(network);
+
+    auto start = chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        catalog.propagateScalar(step * 60.0);
+    }
+    double tScalar = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double propagated = (double)steps * catalog.size();
+    cout << "Orbit propagation, " << catalog.size() << " satellites x " << steps << " steps" << endl;
+    cout << "scalar libm: " << propagated / tScalar / 1e6 << " Msat/s" << endl;
+
+    int cores = (int)thread::hardware_concurrency();
+    cout << "threads    SIMD Msat/s    speedup over scalar" << endl;
+    for (int threads = 1; threads <= cores; threads *= 2) {
+        TaskPool pool(threads);
+        start = chrono::steady_clock::now();
+        for (int step = 0; step < steps; step++) {
+            catalog.propagate(step * 60.0, (threads > 1) ? &pool : nullptr);
+        }
+        double tSimd = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << threads << "          " << propagated / tSimd / 1e6 << "          " << tScalar / tSimd << endl;
+        if (threads < cores && threads * 2 > cores) {
+            threads = cores / 2;    // make sure the last row uses every core
+        }
+    }
+}
+
+void Tester::benchConjunctionScreen() {
+    Random angleGen(0, 62831);
+    vector<Sat> sorted;
+    OrbitCatalog catalog;
+    for (int id = MINID; id <= MAXID; id++) {
+        sorted.push_back(Sat(id, static_cast<ALT>(id % 4), static_cast<INCLIN>((id / 4) % 4), ACTIVE));
+        catalog.setElements(id, angleGen.getRandNum() / 10000.0f, angleGen.getRandNum() / 10000.0f);
+    }
+    SatNet network;
+    network.buildFromSorted(sorted);
+    catalog.load(network);
+    catalog.propagate(3600);
+
+    const float threshold = 10;
+    auto start = chrono::steady_clock::now();
+    vector<Conjunction> brute = ConjunctionScreen::bruteForce(catalog, threshold);
+    double tBrute = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Conjunction screening, " << catalog.size() << " satellites" << endl;
+    cout << "brute force " << threshold << " km: " << tBrute << " ms, " << brute.size() << " pairs" << endl;
+
+    int cores = (int)thread::hardware_concurrency();
+    const float thresholds[3] = {5, 10, 25};
+    cout << "threshold    threads    grid(ms)    pairs    distance checks" << endl;
+    for (int k = 0; k < 3; k++) {
+        for (int threads = 1; threads <= cores; threads *= 2) {
+            TaskPool pool(threads);
+            ConjunctionScreen screen((threads > 1) ? &pool : nullptr);
+            start = chrono::steady_clock::now();
+            vector<Conjunction> pairs = screen.screen(catalog, thresholds[k]);
+            double tGrid = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout << thresholds[k] << "          " << threads << "          " << tGrid << "    " << pairs.size()
+                 << "    " << screen.getCandidates() << (thresholds[k] == threshold && pairs.size() != brute.size() ? " MISMATCH" : "") << endl;
+            if (threads < cores && threads * 2 > cores) {
+                threads = cores / 2;    // make sure the last row uses every core
+            }
+        }
+    }
+}
+
+void Tester::benchBalancePolicy() {
+    const int count = 200000;
+    const char* policy = (SATNET_BALANCE == BALANCE_AVL) ? "AVL"
+                         : (SATNET_BALANCE == BALANCE_REDBLACK) ? "red-black" : "weak AVL";
+    Random idGen(0, 8 * count);
+    vector<int> ids(count);
+    for (int i = 0; i < count; i++) {
+        ids[i] = idGen.getRandNum();
+    }
+
+    // rebuild with -DSATNET_BALANCE=BALANCE_REDBLACK or BALANCE_WAVL to compare
+    cout << "Balancing policy " << policy << ", " << count << " satellites" << endl;
+    cout << "phase              ns/op    rotations/op" << endl;
+    SatNet network;
+    const char* phases[4] = {"random launches", "decay and launch", "ascending launch", "random decays"};
+    for (int phase = 0; phase < 4; phase++) {
+        long long rotations = network.getRotations();
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            if (phase == 0) {
+                network.insert(Sat(ids[i]));
+            } else if (phase == 1) {
+                // each decay frees an ID and a launch takes a new one
+                network.remove(ids[i]);
+                ids[i] = idGen.getRandNum();
+                network.insert(Sat(ids[i]));
+            } else if (phase == 2) {
+                network.insert(Sat(8 * count + 1 + i));
+            } else {
+                network.remove(ids[i]);
+            }
+        }
+        double ops = (phase == 1) ? 2.0 * count : count;
+        double time = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ops;
+        cout << phases[phase] << "    " << time << "    " << (network.getRotations() - rotations) / ops << endl;
+    }
+    bool correct = true;
+    cout << "final height " << checkedHeight(network.m_root, correct) << " for " << network.size() << " satellites" << endl;
+}
@@ -0,0 +1,195 @@
+//
+// Structure-of-arrays orbit catalog and batch propagator.
+//
+
+#include "orbitcatalog.h"
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const double TWO_PI = 6.283185307179586;
+static const double KM_PER_MILE = 1.609344;
+
+// coefficients of the single precision minimax sin and cos on [-pi/4, pi/4]
+static const float SIN_C1 = -1.6666654611e-1f;
+static const float SIN_C2 = 8.3321608736e-3f;
+static const float SIN_C3 = -1.9515295891e-4f;
+static const float COS_C1 = 4.166664568298827e-2f;
+static const float COS_C2 = -1.388731625493765e-3f;
+static const float COS_C3 = 2.443315711809948e-5f;
+// pi/2 split so that q * PIO2_HI is exact for small q
+static const float PIO2_HI = 1.5703125f;
+static const float PIO2_MID = 4.8375129699707031e-4f;
+static const float PIO2_LO = 7.5497899548918821e-8f;
+static const float TWO_OVER_PI = 0.63661977236758134f;
+
+OrbitCatalog::OrbitCatalog(){
+    m_count = 0;
+}
+
+void OrbitCatalog::setElements(int id, float raan, float anomaly){
+    Elements& elements = m_elements[id];
+    elements.m_raan = raan;
+    elements.m_anomaly = anomaly;
+}
+
+void OrbitCatalog::eraseElements(int id){
+    m_elements.erase(id);
+}
+
+void OrbitCatalog::load(const SatNet& network){
+    vector<const Sat*> satellites = network.collectSatellites([](const Sat& s) {return s.getState() != DEORBITED;});
+    m_count = (int)satellites.size();
+    size_t padded = (m_count + PROPAGATE_LANES - 1) / PROPAGATE_LANES * PROPAGATE_LANES;
+    m_ids.assign(m_count, 0);
+    m_shells.assign(m_count, 0);
+    // padding lanes hold a harmless orbit so the kernel never needs a tail loop
+    m_anomaly.assign(padded, 0);
+    m_motion.assign(padded, 0);
+    m_raan.assign(padded, 0);
+    m_raanRate.assign(padded, 0);
+    m_radius.assign(padded, 0);
+    m_cosInclin.assign(padded, 1);
+    m_sinInclin.assign(padded, 0);
+    m_x.assign(padded, 0);
+    m_y.assign(padded, 0);
+    m_z.assign(padded, 0);
+
+    for (int i = 0; i < m_count; i++) {
+        const Sat* satellite = satellites[i];
+        double radius = shellRadius(satellite->getAlt());
+        double inclin = satellite->getInclinDegrees() * TWO_PI / 360;
+        double motion = sqrt(EARTH_MU / (radius * radius * radius));
+        double ratio = EARTH_RADIUS_KM / radius;
+        m_ids[i] = satellite->getID();
+        m_shells[i] = (unsigned char)satellite->getAlt();
+        unordered_map<int, Elements>::const_iterator elements = m_elements.find(satellite->getID());
+        if (elements != m_elements.end()) {
+            m_anomaly[i] = elements->second.m_anomaly;
+            m_raan[i] = elements->second.m_raan;
+        }
+        m_motion[i] = motion;
+        m_raanRate[i] = -1.5 * motion * EARTH_J2 * ratio * ratio * cos(inclin);
+        m_radius[i] = (float)radius;
+        m_cosInclin[i] = (float)cos(inclin);
+        m_sinInclin[i] = (float)sin(inclin);
+    }
+}
+
+double OrbitCatalog::shellRadius(ALT alt){
+    return EARTH_RADIUS_KM + ALT_MILES[alt] * KM_PER_MILE;
+}
+
+void OrbitCatalog::propagate(double time, TaskPool* pool){
+    int padded = (int)m_radius.size();
+    if (pool == nullptr || padded <= PROPAGATE_BLOCK) {
+        propagateRange(time, 0, padded);
+        return;
+    }
+    TaskGroup group(pool);
+    for (int first = 0; first < padded; first += PROPAGATE_BLOCK) {
+        int last = (first + PROPAGATE_BLOCK < padded) ? first + PROPAGATE_BLOCK : padded;
+        group.run([this, time, first, last] {propagateRange(time, first, last);});
+    }
+    group.wait();
+}
+
+void OrbitCatalog::propagateScalar(double time){
+    for (int i = 0; i < m_count; i++) {
+        double u = m_anomaly[i] + m_motion[i] * time;
+        double node = m_raan[i] + m_raanRate[i] * time;
+        double cu = cos(u);
+        double su = sin(u);
+        double cn = cos(node);
+        double sn = sin(node);
+        double ci = m_cosInclin[i];
+        m_x[i] = (float)(m_radius[i] * (cu * cn - su * ci * sn));
+        m_y[i] = (float)(m_radius[i] * (cu * sn + su * ci * cn));
+        m_z[i] = (float)(m_radius[i] * su * m_sinInclin[i]);
+    }
+}
+
+#ifdef __SSE2__
+// anomaly + rate * time for four satellites, reduced to [-pi, pi] in double
+// precision and returned in single precision
+static inline __m128 reduceAngles(const double* base, const double* rate, __m128d time){
+    const __m128d twoPi = _mm_set1_pd(TWO_PI);
+    const __m128d invTwoPi = _mm_set1_pd(1 / TWO_PI);
+    __m128d low = _mm_add_pd(_mm_loadu_pd(base), _mm_mul_pd(_mm_loadu_pd(rate), time));
+    __m128d high = _mm_add_pd(_mm_loadu_pd(base + 2), _mm_mul_pd(_mm_loadu_pd(rate + 2), time));
+    low = _mm_sub_pd(low, _mm_mul_pd(_mm_cvtepi32_pd(_mm_cvtpd_epi32(_mm_mul_pd(low, invTwoPi))), twoPi));
+    high = _mm_sub_pd(high, _mm_mul_pd(_mm_cvtepi32_pd(_mm_cvtpd_epi32(_mm_mul_pd(high, invTwoPi))), twoPi));
+    return _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+}
+
+// sin and cos of four angles in [-pi, pi]: reduce by quadrant to [-pi/4, pi/4],
+// evaluate both polynomials and swap or negate them by quadrant without branches
+static inline void sincos4(__m128 x, __m128& sine, __m128& cosine){
+    __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+    __m128 q = _mm_cvtepi32_ps(quadrant);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(PIO2_HI)));
+    r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PIO2_MID)));
+    r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PIO2_LO)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C3), r2), _mm_set1_ps(SIN_C2));
+    s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(SIN_C1));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, r2), r), r);
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_C3), r2), _mm_set1_ps(COS_C2));
+    c = _mm_add_ps(_mm_mul_ps(c, r2), _mm_set1_ps(COS_C1));
+    c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c, r2), r2), _mm_sub_ps(_mm_set1_ps(1), _mm_mul_ps(r2, _mm_set1_ps(0.5f))));
+
+    // odd quadrants swap sin and cos, quadrants 2 and 3 negate sin, 1 and 2 negate cos
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    sine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sinSign);
+    cosine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosSign);
+}
+
+void OrbitCatalog::propagateRange(double time, int first, int last){
+    __m128d t = _mm_set1_pd(time);
+    for (int i = first; i < last; i += PROPAGATE_LANES) {
+        __m128 su, cu, sn, cn;
+        sincos4(reduceAngles(&m_anomaly[i], &m_motion[i], t), su, cu);
+        sincos4(reduceAngles(&m_raan[i], &m_raanRate[i], t), sn, cn);
+        __m128 radius = _mm_loadu_ps(&m_radius[i]);
+        __m128 ci = _mm_loadu_ps(&m_cosInclin[i]);
+        __m128 suci = _mm_mul_ps(su, ci);
+        _mm_storeu_ps(&m_x[i], _mm_mul_ps(radius, _mm_sub_ps(_mm_mul_ps(cu, cn), _mm_mul_ps(suci, sn))));
+        _mm_storeu_ps(&m_y[i], _mm_mul_ps(radius, _mm_add_ps(_mm_mul_ps(cu, sn), _mm_mul_ps(suci, cn))));
+        _mm_storeu_ps(&m_z[i], _mm_mul_ps(radius, _mm_mul_ps(su, _mm_loadu_ps(&m_sinInclin[i]))));
+    }
+}
+#else
+// the same reduction and polynomials one lane at a time
+static inline void sincos1(double angle, float& sine, float& cosine){
+    float x = (float)(angle - nearbyint(angle / TWO_PI) * TWO_PI);
+    int quadrant = (int)nearbyintf(x * TWO_OVER_PI);
+    float q = (float)quadrant;
+    float r = ((x - q * PIO2_HI) - q * PIO2_MID) - q * PIO2_LO;
+    float r2 = r * r;
+    float s = ((SIN_C3 * r2 + SIN_C2) * r2 + SIN_C1) * r2 * r + r;
+    float c = ((COS_C3 * r2 + COS_C2) * r2 + COS_C1) * r2 * r2 + (1 - 0.5f * r2);
+    sine = (quadrant & 1) ? c : s;
+    cosine = (quadrant & 1) ? s : c;
+    if (quadrant & 2) {
+        sine = -sine;
+    }
+    if ((quadrant + 1) & 2) {
+        cosine = -cosine;
+    }
+}
+
+void OrbitCatalog::propagateRange(double time, int first, int last){
+    for (int i = first; i < last; i++) {
+        float su, cu, sn, cn;
+        sincos1(m_anomaly[i] + m_motion[i] * time, su, cu);
+        sincos1(m_raan[i] + m_raanRate[i] * time, sn, cn);
+        m_x[i] = m_radius[i] * (cu * cn - su * m_cosInclin[i] * sn);
+        m_y[i] = m_radius[i] * (cu * sn + su * m_cosInclin[i] * cn);
+        m_z[i] = m_radius[i] * su * m_sinInclin[i];
+    }
+}
+#endif
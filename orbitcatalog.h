@@ -0,0 +1,72 @@
+//
+// Structure-of-arrays orbit catalog and batch propagator.
+// A snapshot of a SatNet is laid out as one array per orbital element so
+// a time step streams through contiguous memory. Orbits are circular:
+// the semi-major axis comes from the altitude shell and the inclination
+// from its bucket, the node drifts with the J2 nodal precession and the
+// satellite moves with its mean motion. The node and anomaly at the epoch
+// are kept here by ID rather than in the tree, so SatNet nodes stay small
+// for users that never propagate. Positions are Earth-centered inertial,
+// in kilometers.
+//
+
+#ifndef ORBITCATALOG_H
+#define ORBITCATALOG_H
+#include "satnet.h"
+#include <unordered_map>
+#include <vector>
+
+#define EARTH_RADIUS_KM 6378.137
+#define EARTH_MU 398600.4418        // km^3/s^2
+#define EARTH_J2 1.08262668e-3
+#define PROPAGATE_LANES 4           // satellites per SIMD step, arrays are padded to it
+#define PROPAGATE_BLOCK 4096        // satellites per task when a pool is used
+
+class OrbitCatalog{
+public:
+    friend class Tester;
+    OrbitCatalog();
+    // node and mean anomaly at the epoch in radians for a satellite ID, used
+    // by the next load; satellites without elements start at 0 and 0
+    void setElements(int id, float raan, float anomaly);
+    void eraseElements(int id);
+    // replaces the catalog with the satellites of the network that are not deorbited, in ID order
+    void load(const SatNet& network);
+    int size() const {return m_count;}
+    int getID(int index) const {return m_ids[index];}
+    ALT getShell(int index) const {return static_cast<ALT>(m_shells[index]);}
+    static double shellRadius(ALT alt);     // km from the Earth's center
+    // positions at time seconds after the epoch, vectorized polynomial sin/cos in
+    // single precision after a double precision angle reduction; split over the
+    // pool by block when there is one
+    void propagate(double time, TaskPool* pool = nullptr);
+    // the same model with double precision libm sin/cos, one satellite at a time
+    void propagateScalar(double time);
+    const float* getX() const {return m_x.data();}
+    const float* getY() const {return m_y.data();}
+    const float* getZ() const {return m_z.data();}
+
+private:
+    class Elements{
+    public:
+        float m_raan;
+        float m_anomaly;
+    };
+    unordered_map<int, Elements> m_elements;    // epoch angles by ID, kept across loads
+    int m_count;                // satellites, the arrays hold m_count rounded up to PROPAGATE_LANES
+    vector<int> m_ids;
+    vector<unsigned char> m_shells;
+    vector<double> m_anomaly;   // mean anomaly at the epoch, radians
+    vector<double> m_motion;    // mean motion, radians per second
+    vector<double> m_raan;      // node at the epoch, radians
+    vector<double> m_raanRate;  // J2 nodal drift, radians per second
+    vector<float> m_radius;     // km
+    vector<float> m_cosInclin;
+    vector<float> m_sinInclin;
+    vector<float> m_x;
+    vector<float> m_y;
+    vector<float> m_z;
+
+    void propagateRange(double time, int first, int last);
+};
+#endif
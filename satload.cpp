@@ -0,0 +1,172 @@
+//
+// Load generator for satnetd.
+// usage: satload <socket path> [connections] [pipeline depth] [requests per connection]
+//
+// Every connection runs in its own thread and keeps up to depth requests
+// in flight: 70% find, 20% setState, 5% insert, 5% remove on uniform IDs.
+// Latency is measured from the send of a request to the arrival of its
+// response, so at depth > 1 it includes the time spent queued behind the
+// requests sent before it.
+//
+
+#include "satnet.h"
+#include "satproto.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+class LoadResult{
+public:
+    vector<double> m_latency;   // microseconds per request
+    long long m_status[4] = {0};
+    bool m_failed = false;
+};
+
+static int connectTo(const char* path){
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool sendAll(int fd, const unsigned char* data, size_t size){
+    while (size > 0) {
+        ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+static void runConnection(const char* path, int depth, int requests, int seed, LoadResult& result){
+    int fd = connectTo(path);
+    if (fd < 0) {
+        result.m_failed = true;
+        return;
+    }
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> idDist(MINID, MAXID);
+    std::uniform_int_distribution<int> opDist(0, 99);
+    std::deque<std::chrono::steady_clock::time_point> inFlight;
+    vector<unsigned char> out;
+    unsigned char in[PROTO_FRAME * 1024];
+    size_t buffered = 0;
+    int sent = 0;
+    int received = 0;
+    result.m_latency.reserve(requests);
+
+    while (received < requests) {
+        // top the pipeline up with a single send
+        out.clear();
+        while (sent < requests && (int)inFlight.size() < depth) {
+            int op = opDist(generator);
+            int id = idDist(generator);
+            ProtoRequest request;
+            if (op < 70) request = ProtoRequest(P_FIND, id);
+            else if (op < 90) request = ProtoRequest(P_SETSTATE, id, (unsigned char)(op % 2 ? DECAYING : ACTIVE));
+            else if (op < 95) request = ProtoRequest(P_INSERT, id, (unsigned char)(id % 4 | (id % 4) << 2));
+            else request = ProtoRequest(P_REMOVE, id);
+            out.resize(out.size() + PROTO_FRAME);
+            request.encode(out.data() + out.size() - PROTO_FRAME);
+            inFlight.push_back(std::chrono::steady_clock::now());
+            sent++;
+        }
+        if (!out.empty() && !sendAll(fd, out.data(), out.size())) {
+            result.m_failed = true;
+            break;
+        }
+
+        ssize_t count = recv(fd, in + buffered, sizeof(in) - buffered, 0);
+        if (count <= 0) {
+            result.m_failed = true;
+            break;
+        }
+        buffered += (size_t)count;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        size_t frames = buffered / PROTO_FRAME;
+        for (size_t i = 0; i < frames; i++) {
+            ProtoResponse response;
+            response.decode(in + i * PROTO_FRAME);
+            result.m_status[response.m_status & 3]++;
+            result.m_latency.push_back(std::chrono::duration<double, std::micro>(now - inFlight.front()).count());
+            inFlight.pop_front();
+            received++;
+        }
+        buffered -= frames * PROTO_FRAME;
+        memmove(in, in + frames * PROTO_FRAME, buffered);
+    }
+    close(fd);
+}
+
+int main(int argc, char* argv[]){
+    if (argc < 2) {
+        cout << "usage: " << argv[0] << " <socket path> [connections] [pipeline depth] [requests per connection]" << endl;
+        return 1;
+    }
+    const char* path = argv[1];
+    int connections = (argc > 2) ? atoi(argv[2]) : 4;
+    int depth = (argc > 3) ? atoi(argv[3]) : 64;
+    int requests = (argc > 4) ? atoi(argv[4]) : 200000;
+    if (connections < 1 || depth < 1 || requests < 1) {
+        cout << "connections, depth and requests must be positive" << endl;
+        return 1;
+    }
+
+    vector<LoadResult> results(connections);
+    vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < connections; i++) {
+        threads.push_back(std::thread(runConnection, path, depth, requests, i + 1, std::ref(results[i])));
+    }
+    for (int i = 0; i < connections; i++) {
+        threads[i].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    vector<double> latency;
+    long long status[4] = {0};
+    for (int i = 0; i < connections; i++) {
+        if (results[i].m_failed) {
+            cout << "connection " << i << " failed" << endl;
+        }
+        latency.insert(latency.end(), results[i].m_latency.begin(), results[i].m_latency.end());
+        for (int s = 0; s < 4; s++) {
+            status[s] += results[i].m_status[s];
+        }
+    }
+    if (latency.empty()) {
+        return 1;
+    }
+    std::sort(latency.begin(), latency.end());
+    const double points[5] = {50, 90, 99, 99.9, 100};
+    const char* names[5] = {"p50", "p90", "p99", "p99.9", "max"};
+
+    cout << latency.size() << " requests over " << connections << " connections, depth " << depth
+         << ", in " << seconds << " s" << endl;
+    cout << "throughput: " << latency.size() / seconds << " requests/s" << endl;
+    cout << "latency us";
+    for (int i = 0; i < 5; i++) {
+        cout << "  " << names[i] << ": " << latency[(size_t)(points[i] / 100.0 * (latency.size() - 1))];
+    }
+    cout << endl;
+    cout << "ok: " << status[S_OK] << "  not found: " << status[S_NOTFOUND] << "  exists: " << status[S_EXISTS]
+         << "  bad request: " << status[S_BADREQUEST] << endl;
+    return 0;
+}
@@ -3,12 +3,28 @@
 //
 
 #include "satnet.h"
+#include "changefeed.h"
+#include "satrace.h"
 #include <stack>
+#include <algorithm>
 SatNet::SatNet(){
     m_root = nullptr;
+    m_pool = nullptr;
+    m_nodes = 0;
+    m_tombstones = 0;
+    m_lazy = false;
+    m_tombstoneRatio = DEFAULT_TOMBSTONE_RATIO;
+    m_tracer = nullptr;
+    m_cacheShift = 32;
+    m_cacheHits = 0;
+    m_cacheMisses = 0;
+    m_version = 0;
+    m_rotations = 0;
 }
 
 SatNet::~SatNet(){
+m_feeds.clear();
+m_tracer = nullptr;
 clear();
 }
 
@@ -23,6 +39,17 @@ int SatNet:: calculateBalance(Sat* node) {
     return leftHeight - rightHeight;
 }
 
+// the rank of a possibly missing node
+static int rankOf(const Sat* node) {
+    return (node != nullptr) ? node->getHeight() : 0;
+}
+
+// recomputes the height of a node from its children, AVL ranks are heights
+static void updateHeight(Sat* node) {
+    node->setHeight(1 + max(rankOf(node->getLeft()), rankOf(node->getRight())));
+}
+
+// rotations only relink, each policy sets the ranks it needs afterwards
 Sat* SatNet::rotateRight(Sat* y) {
     Sat* x = y->getLeft();
     Sat* T2 = x->getRight();
@@ -30,17 +57,7 @@ Sat* SatNet::rotateRight(Sat* y) {
     // rotation
     x->setRight(y);
     y->setLeft(T2);
-
-    // Update heights
-
-    int leftHeight = (y->getLeft() != nullptr) ? y->getLeft()->getHeight() : 0;
-    int rightHeight = (y->getRight() != nullptr) ? y->getRight()->getHeight() : 0;
-    y->setHeight(1 + max(leftHeight, rightHeight));
-
-    leftHeight = (x->getLeft() != nullptr) ? x->getLeft()->getHeight() : 0;
-    rightHeight = (x->getRight() != nullptr) ? x->getRight()->getHeight() : 0;
-    x->setHeight(1 + max(leftHeight, rightHeight));
-
+    m_rotations++;
     return x;
 }
 
@@ -51,75 +68,282 @@ Sat* SatNet::rotateLeft(Sat* x) {
     // rotation
     y->setLeft(x);
     x->setRight(T2);
+    m_rotations++;
+    return y;
+}
 
-    // Update heights
+// updates the height of node and rotates its subtree back into AVL shape,
+// returns the new root of the subtree
+Sat* SatNet::rebalance(Sat* node) {
+    updateHeight(node);
+    int balance = calculateBalance(node);
 
-    int leftHeight = (x->getLeft() != nullptr) ? x->getLeft()->getHeight() : 0;
-    int rightHeight = (x->getRight() != nullptr) ? x->getRight()->getHeight() : 0;
-    x->setHeight(1 + max(leftHeight, rightHeight));
+    // rotations to rebalance the tree
+    if (balance > 1) {
+        if (calculateBalance(node->getLeft()) < 0) {
+            Sat* left = rotateLeft(node->getLeft());
+            updateHeight(left->getLeft());
+            updateHeight(left);
+            node->setLeft(left);
+        }
+        Sat* top = rotateRight(node);
+        updateHeight(node);
+        updateHeight(top);
+        return top;
+    }
+    if (balance < -1) {
+        if (calculateBalance(node->getRight()) > 0) {
+            Sat* right = rotateRight(node->getRight());
+            updateHeight(right->getRight());
+            updateHeight(right);
+            node->setRight(right);
+        }
+        Sat* top = rotateLeft(node);
+        updateHeight(node);
+        updateHeight(top);
+        return top;
+    }
 
+    return node;
+}
 
-    leftHeight = (y->getLeft() != nullptr) ? y->getLeft()->getHeight() : 0;
-    rightHeight = (y->getRight() != nullptr) ? y->getRight()->getHeight() : 0;
-    y->setHeight(1 + max(leftHeight, rightHeight));
+#if SATNET_BALANCE == BALANCE_AVL
+Sat* SatNet::fixInsert(Sat* node) {
+    return rebalance(node);
+}
 
-    return y;
+Sat* SatNet::fixRemove(Sat* node) {
+    return rebalance(node);
 }
 
-Sat* SatNet::insertHelper(Sat* node, const Sat& satellite) {
-    if (node == nullptr) {
-        Sat* newNode = new Sat(satellite);
-        newNode->setHeight(1);
-        return newNode;
+void SatNet::setBuiltRank(Sat* node) {
+    updateHeight(node);
+}
+#elif SATNET_BALANCE == BALANCE_REDBLACK
+// a red node has the rank of its parent, so red means rank difference 0
+
+// node is black or the root; a red child with a red child below it came from
+// an insert, and is fixed by recoloring or by at most two rotations
+Sat* SatNet::fixInsert(Sat* node) {
+    int rank = node->getHeight();
+    for (int side = 0; side < 2; side++) {
+        Sat* child = (side == 0) ? node->getLeft() : node->getRight();
+        if (rankOf(child) != rank) {
+            continue;
+        }
+        Sat* outer = (side == 0) ? child->getLeft() : child->getRight();
+        Sat* inner = (side == 0) ? child->getRight() : child->getLeft();
+        bool outerRed = rankOf(outer) == rank;
+        if (!outerRed && rankOf(inner) != rank) {
+            continue;
+        }
+        Sat* uncle = (side == 0) ? node->getRight() : node->getLeft();
+        if (rankOf(uncle) == rank) {
+            // red uncle: blacken both children, the node turns red
+            node->setHeight(rank + 1);
+            return node;
+        }
+        // black uncle: the middle of the three red-linked nodes goes on top,
+        // ranks are unchanged
+        if (side == 0) {
+            if (!outerRed) {
+                node->setLeft(rotateLeft(child));
+            }
+            return rotateRight(node);
+        }
+        if (!outerRed) {
+            node->setRight(rotateRight(child));
+        }
+        return rotateLeft(node);
     }
+    return node;
+}
 
-    if (satellite.getID() < node->getID()) {
-        if (node->getLeft() == nullptr) {
-            node->setLeft(new Sat(satellite));
+// a child of node lost a black rank and is now a rank difference 2 below it
+Sat* SatNet::fixRemove(Sat* node) {
+    int rank = node->getHeight();
+    bool left;
+    if (rank - rankOf(node->getLeft()) == 2) {
+        left = true;
+    } else if (rank - rankOf(node->getRight()) == 2) {
+        left = false;
+    } else {
+        return node;
+    }
+    Sat* sibling = left ? node->getRight() : node->getLeft();
+    if (rankOf(sibling) == rank) {
+        // red sibling: rotate it up so the short side gets a black sibling
+        Sat* top = left ? rotateLeft(node) : rotateRight(node);
+        if (left) {
+            top->setLeft(fixRemove(node));
         } else {
-            node->setLeft(insertHelper(node->getLeft(), satellite));
+            top->setRight(fixRemove(node));
         }
-    } else if (satellite.getID() > node->getID()) {
-        if (node->getRight() == nullptr) {
-            node->setRight(new Sat(satellite));
+        return top;
+    }
+    Sat* outer = left ? sibling->getRight() : sibling->getLeft();
+    Sat* inner = left ? sibling->getLeft() : sibling->getRight();
+    int siblingRank = rank - 1;
+    if (rankOf(outer) == siblingRank) {
+        // red far nephew: one rotation, the sibling takes the node's rank
+        Sat* top = left ? rotateLeft(node) : rotateRight(node);
+        top->setHeight(rank);
+        node->setHeight(rank - 1);
+        return top;
+    }
+    if (rankOf(inner) == siblingRank) {
+        // red near nephew: two rotations bring it up with the node's rank
+        if (left) {
+            node->setRight(rotateRight(sibling));
         } else {
-            node->setRight(insertHelper(node->getRight(), satellite));
+            node->setLeft(rotateLeft(sibling));
         }
-    } else {
+        Sat* top = left ? rotateLeft(node) : rotateRight(node);
+        top->setHeight(rank);
+        node->setHeight(rank - 1);
+        return top;
+    }
+    // black nephews: the sibling turns red, the shortage moves up unless the node was red
+    node->setHeight(rank - 1);
+    return node;
+}
 
-        return node;
+void SatNet::setBuiltRank(Sat* node) {
+    // a midpoint build is balanced to within one level, so the shorter side
+    // sets the black height and the deeper nodes are red
+    node->setHeight(1 + min(rankOf(node->getLeft()), rankOf(node->getRight())));
+}
+#else
+// weak AVL: every rank difference is 1 or 2 and leaves have rank 1
+
+// a child of node may have been promoted to the node's rank
+Sat* SatNet::fixInsert(Sat* node) {
+    int rank = node->getHeight();
+    for (int side = 0; side < 2; side++) {
+        Sat* child = (side == 0) ? node->getLeft() : node->getRight();
+        if (rankOf(child) != rank) {
+            continue;
+        }
+        Sat* sibling = (side == 0) ? node->getRight() : node->getLeft();
+        if (rank - rankOf(sibling) == 1) {
+            node->setHeight(rank + 1);
+            return node;
+        }
+        Sat* inner = (side == 0) ? child->getRight() : child->getLeft();
+        if (rank - rankOf(inner) == 2) {
+            Sat* top = (side == 0) ? rotateRight(node) : rotateLeft(node);
+            node->setHeight(rank - 1);
+            return top;
+        }
+        // the inner grandchild goes on top and takes the node's rank
+        if (side == 0) {
+            node->setLeft(rotateLeft(child));
+        } else {
+            node->setRight(rotateRight(child));
+        }
+        Sat* top = (side == 0) ? rotateRight(node) : rotateLeft(node);
+        top->setHeight(rank);
+        child->setHeight(rank - 1);
+        node->setHeight(rank - 1);
+        return top;
     }
+    return node;
+}
 
-    // Update height and balance factor
-    int leftHeight = (node->getLeft() != nullptr) ? node->getLeft()->getHeight() : 0;
-    int rightHeight = (node->getRight() != nullptr) ? node->getRight()->getHeight() : 0;
-    node->setHeight(1 + max(leftHeight, rightHeight));
+// a child of node may have dropped to a rank difference of 3, or the node
+// may have become a leaf at rank 2
+Sat* SatNet::fixRemove(Sat* node) {
+    int rank = node->getHeight();
+    if (node->getLeft() == nullptr && node->getRight() == nullptr) {
+        node->setHeight(1);
+        return node;
+    }
+    bool left;
+    if (rank - rankOf(node->getLeft()) == 3) {
+        left = true;
+    } else if (rank - rankOf(node->getRight()) == 3) {
+        left = false;
+    } else {
+        return node;
+    }
+    Sat* sibling = left ? node->getRight() : node->getLeft();
+    int siblingRank = rankOf(sibling);
+    if (rank - siblingRank == 2) {
+        node->setHeight(rank - 1);
+        return node;
+    }
+    Sat* outer = left ? sibling->getRight() : sibling->getLeft();
+    Sat* inner = left ? sibling->getLeft() : sibling->getRight();
+    if (siblingRank - rankOf(outer) == 2 && siblingRank - rankOf(inner) == 2) {
+        node->setHeight(rank - 1);
+        sibling->setHeight(siblingRank - 1);
+        return node;
+    }
+    if (siblingRank - rankOf(outer) == 1) {
+        Sat* top = left ? rotateLeft(node) : rotateRight(node);
+        top->setHeight(rank);
+        // a node left without children must be a leaf at rank 1
+        node->setHeight((node->getLeft() == nullptr && node->getRight() == nullptr) ? 1 : rank - 1);
+        return top;
+    }
+    if (left) {
+        node->setRight(rotateRight(sibling));
+    } else {
+        node->setLeft(rotateLeft(sibling));
+    }
+    Sat* top = left ? rotateLeft(node) : rotateRight(node);
+    top->setHeight(rank);
+    sibling->setHeight(siblingRank - 1);
+    node->setHeight(rank - 2);
+    return top;
+}
 
-    int balance = leftHeight - rightHeight;
+void SatNet::setBuiltRank(Sat* node) {
+    updateHeight(node);
+}
+#endif
 
-    // Perform rotations
-    if (balance > 1) {
-        if (satellite.getID() < node->getLeft()->getID()) {
-            return rotateRight(node);
-        } else {
-            node->setLeft(rotateLeft(node->getLeft()));
-            return rotateRight(node);
-        }
+Sat* SatNet::insertHelper(Sat* node, const Sat& satellite) {
+    if (node == nullptr) {
+        Sat* newNode = new Sat(satellite);
+        newNode->setHeight(1);
+        newNode->setDeleted(false);
+        m_nodes++;
+        return newNode;
     }
-    if (balance < -1) {
-        if (satellite.getID() > node->getRight()->getID()) {
-            return rotateLeft(node);
-        } else {
-            node->setRight(rotateRight(node->getRight()));
-            return rotateLeft(node);
+
+    if (satellite.getID() < node->getID()) {
+        node->setLeft(insertHelper(node->getLeft(), satellite));
+    } else if (satellite.getID() > node->getID()) {
+        node->setRight(insertHelper(node->getRight(), satellite));
+    } else {
+        if (node->isDeleted()) {
+            // the ID was lazily removed, bring the node back with the new payload
+            node->setAlt(satellite.getAlt());
+            node->setInclin(satellite.getInclin());
+            node->setState(satellite.getState());
+            node->setDeleted(false);
+            m_tombstones--;
         }
+        return node;
     }
 
-    return node;
+    return fixInsert(node);
 }
 
 void SatNet::insert(const Sat& satellite){
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_INSERT, satellite.getID(),
+                         (unsigned char)(satellite.getAlt() | (satellite.getInclin() << 2) | (satellite.getState() << 4)));
+    }
+    int nodes = m_nodes;
+    int tombstones = m_tombstones;
+    m_version++;
     m_root = insertHelper(m_root, satellite);
+    if (m_nodes != nodes || m_tombstones != tombstones) {
+        m_present.set(satellite.getID());
+        publish(SatChange(INSERTED, satellite.getID(), satellite.getAlt(), satellite.getInclin(), satellite.getState()));
+    }
 }
 
 
@@ -130,17 +354,47 @@ void SatNet::clearHelper(Sat *node) {
         delete node;
     }
 }
+void SatNet::clearParallel(Sat *node) {
+    if (node == nullptr) {
+        return;
+    }
+    if (node->getHeight() <= PARALLEL_CUTOFF_HEIGHT) {
+        clearHelper(node);
+        return;
+    }
+    TaskGroup group(m_pool);
+    Sat* left = node->m_left;
+    group.run([this, left] {clearParallel(left);});
+    clearParallel(node->m_right);
+    group.wait();
+    delete node;
+}
 void SatNet::clear(){
-    clearHelper(m_root);
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_CLEAR);
+    }
+    flushCache();
+    m_present.clear();
+    m_version++;
+    if (m_pool != nullptr) {
+        clearParallel(m_root);
+    } else {
+        clearHelper(m_root);
+    }
     m_root = nullptr;
+    m_nodes = 0;
+    m_tombstones = 0;
+    publish(SatChange(RESET));
 }
 
-Sat* SatNet::findMin(Sat* node) {
-    Sat* current = node;
-    while (current->getLeft() != nullptr) {
-        current = current->getLeft();
+// unlinks the smallest node of the subtree, returns the rebalanced rest
+Sat* SatNet::detachMin(Sat* node, Sat*& minNode) {
+    if (node->getLeft() == nullptr) {
+        minNode = node;
+        return node->getRight();
     }
-    return current;
+    node->setLeft(detachMin(node->getLeft(), minNode));
+    return fixRemove(node);
 }
 
 Sat* SatNet::removeHelper(Sat* node, int id) {
@@ -155,63 +409,66 @@ Sat* SatNet::removeHelper(Sat* node, int id) {
         node->setRight(removeHelper(node->getRight(), id));
     }
     else {
-        //  only one child or no child
+        // nodes are relinked, never copied, so every other satellite keeps its address
+        Sat* doomed = node;
         if (node->getLeft() == nullptr || node->getRight() == nullptr) {
-            Sat* temp = (node->getLeft() != nullptr) ? node->getLeft() : node->getRight();
-
-            // No child
-            if (temp == nullptr) {
-                temp = node;
-                node = nullptr;
-            } else { // One child
-                *node = *temp;
-            }
-
-            delete temp;
+            //  only one child or no child, the child takes the place of the node
+            node = (node->getLeft() != nullptr) ? node->getLeft() : node->getRight();
         } else {
-            Sat* temp = findMin(node->getRight());
-
-            *node = *temp;
-
-            node->setRight(removeHelper(node->getRight(), temp->getID()));
+            // the successor is unlinked from the right subtree and takes the place of the node
+            Sat* successor = nullptr;
+            Sat* right = detachMin(node->getRight(), successor);
+            successor->setLeft(node->getLeft());
+            successor->setRight(right);
+            successor->setHeight(node->getHeight());
+            node = successor;
         }
+
+        invalidate(doomed->getID());
+        m_present.reset(doomed->getID());
+        delete doomed;
+        m_nodes--;
     }
 
     if (node == nullptr) {
         return node;
     }
 
-    // Update height of current node
-    int leftHeight = (node->getLeft() != nullptr) ? node->getLeft()->getHeight() : 0;
-    int rightHeight = (node->getRight() != nullptr) ? node->getRight()->getHeight() : 0;
-    node->setHeight(1 + max(leftHeight, rightHeight));
-
-    // Calculate balance factor
-    int balance = calculateBalance(node);
+    return fixRemove(node);
+}
 
-    // rotations to rebalance the tree
-    if (balance > 1) {
-        if (calculateBalance(node->getLeft()) >= 0) {
-            return rotateRight(node);
-        } else {
-            node->setLeft(rotateLeft(node->getLeft()));
-            return rotateRight(node);
-        }
+void SatNet::remove(int id){
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_REMOVE, id);
     }
-    if (balance < -1) {
-        if (calculateBalance(node->getRight()) <= 0) {
-            return rotateLeft(node);
-        } else {
-            node->setRight(rotateRight(node->getRight()));
-            return rotateLeft(node);
+    if (SatBitmap::inRange(id) && !m_present.test(id)) {
+        return;
+    }
+    if (!m_lazy) {
+        int nodes = m_nodes;
+        m_version++;
+        m_root = removeHelper(m_root, id);
+        if (m_nodes != nodes) {
+            publish(SatChange(REMOVED, id));
         }
+        return;
     }
 
-    return node;
-}
-
-void SatNet::remove(int id){
-    m_root = removeHelper(m_root, id);
+    // lazy removal only marks the node, no rotations
+    Sat* node = m_root;
+    while (node != nullptr && node->getID() != id) {
+        node = (id < node->getID()) ? node->getLeft() : node->getRight();
+    }
+    if (node == nullptr || node->isDeleted()) {
+        return;
+    }
+    node->setDeleted(true);
+    m_present.reset(id);
+    m_tombstones++;
+    publish(SatChange(REMOVED, id));
+    if (m_tombstones > m_tombstoneRatio * m_nodes) {
+        compact();
+    }
 }
 void SatNet::dumpTree() const {
     dump(m_root);
@@ -227,20 +484,33 @@ void SatNet::dump(Sat* satellite) const{
     }
 }
 
-void SatNet::listSatellitesHelper(Sat* node) const {
-    if (node != nullptr) {
-        listSatellitesHelper(node->getLeft());
-
+void SatNet::listSatellites() const {
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_LIST);
+    }
+    vector<const Sat*> satellites = collectSatellites([](const Sat&) {return true;});
+    for (size_t i = 0; i < satellites.size(); i++) {
+        const Sat* node = satellites[i];
         cout << node->getID() << ": " << node->getStateStr() << ": " << node->getInclinStr() << ": " << node->getAltStr() << endl;
-
-        listSatellitesHelper(node->getRight());
     }
 }
-void SatNet::listSatellites() const {
-    listSatellitesHelper(m_root);
-}
 
 bool SatNet::setState(int id, STATE state){
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_SETSTATE, id, (unsigned char)state);
+    }
+    if (SatBitmap::inRange(id) && !m_present.test(id)) {
+        return false;
+    }
+    if (!m_cache.empty()) {
+        Sat* node = cachedLookup(id);
+        if (node == nullptr || node->isDeleted()) {
+            return false;
+        }
+        node->setState(state);
+        publish(SatChange(STATECHANGED, id, node->getAlt(), node->getInclin(), state));
+        return true;
+    }
     return setStateHelper(m_root, id, state);
 }
 
@@ -255,26 +525,60 @@ bool SatNet::setStateHelper(Sat* node, int id, STATE state) {
     } else if (id > node->getID()) {
         // search right subtree
         return setStateHelper(node->getRight(), id, state);
+    } else if (node->isDeleted()) {
+        return false;
     } else {
         node->setState(state);
+        publish(SatChange(STATECHANGED, id, node->getAlt(), node->getInclin(), state));
         return true;
     }
 }
-void SatNet::removeDeorbited() {
-    removeDeorbitedHelper(m_root);
+int SatNet::setStates(const vector<pair<int, STATE>>& changes) {
+    if (m_tracer != nullptr) {
+        for (size_t i = 0; i < changes.size(); i++) {
+            m_tracer->record(T_SETSTATE, changes[i].first, (unsigned char)changes[i].second);
+        }
+    }
+    return setStatesHelper(m_root, changes.data(), changes.data() + changes.size());
 }
 
-void SatNet::removeDeorbitedHelper(Sat*& node) {
-    if (node == nullptr) {
-        return;
+int SatNet::setStatesHelper(Sat* node, const pair<int, STATE>* first, const pair<int, STATE>* last) {
+    if (node == nullptr || first == last) {
+        return 0;
     }
 
-    removeDeorbitedHelper(node->m_left);
-    removeDeorbitedHelper(node->m_right);
+    // split the sorted run around this node, each half only visits its own subtree
+    const pair<int, STATE>* mid = lower_bound(first, last, node->getID(),
+        [](const pair<int, STATE>& change, int id) {return change.first < id;});
+    int found = setStatesHelper(node->getLeft(), first, mid);
+    if (mid != last && mid->first == node->getID()) {
+        if (!node->isDeleted()) {
+            node->setState(mid->second);
+            publish(SatChange(STATECHANGED, node->getID(), node->getAlt(), node->getInclin(), mid->second));
+            found++;
+        }
+        mid++;
+    }
+    return found + setStatesHelper(node->getRight(), mid, last);
+}
 
-    if (node->getState() == DEORBITED) {
-        node = removeHelper(node, node->getID());
+void SatNet::removeDeorbited() {
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_REMOVEDEORBITED);
+    }
+    // a read-only count is cheaper than a relink and keeps cursors and the cache valid
+    if (count<DEORBITED>() == 0) {
+        return;
     }
+    m_version++;
+    // removing nodes bottom-up one at a time can shrink a subtree by more than
+    // a rotation repairs, so the survivors are relinked into a balanced tree in
+    // one linear pass instead, tombstones are dropped on the way
+    vector<Sat*> live;
+    collectLive(m_root, live, true);
+    m_root = relinkHelper(live, 0, (int)live.size() - 1);
+    m_nodes = (int)live.size();
+    m_tombstones = 0;
 }
 
 bool SatNet::findSatelliteHelper(Sat* node, int id) const {
@@ -282,7 +586,7 @@ bool SatNet::findSatelliteHelper(Sat* node, int id) const {
         return false;
     }
     if (id == node->getID()) {
-        return true;
+        return !node->isDeleted();
     }
     if (id < node->getID()) {
         return findSatelliteHelper(node->getLeft(), id);
@@ -291,6 +595,16 @@ bool SatNet::findSatelliteHelper(Sat* node, int id) const {
     }
 }
 bool SatNet::findSatellite(int id) const {
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_FIND, id);
+    }
+    if (SatBitmap::inRange(id) && !m_present.test(id)) {
+        return false;
+    }
+    if (!m_cache.empty()) {
+        Sat* node = cachedLookup(id);
+        return node != nullptr && !node->isDeleted();
+    }
     return findSatelliteHelper(m_root, id);
 }
 
@@ -307,6 +621,25 @@ Sat* SatNet::deepCopy(const Sat* node) {
     return newSat;
 }
 
+Sat* SatNet::deepCopyParallel(const Sat* node) {
+    if (node == nullptr) {
+        return nullptr;
+    }
+    if (node->getHeight() <= PARALLEL_CUTOFF_HEIGHT) {
+        return deepCopy(node);
+    }
+
+    Sat* newSat = new Sat(*node);
+    Sat* left = nullptr;
+    TaskGroup group(m_pool);
+    group.run([this, node, &left] {left = deepCopyParallel(node->getLeft());});
+    newSat->setRight(deepCopyParallel(node->getRight()));
+    group.wait();
+    newSat->setLeft(left);
+
+    return newSat;
+}
+
 const SatNet & SatNet::operator=(const SatNet & rhs){
     if (this == &rhs) {
         return *this;
@@ -316,30 +649,574 @@ const SatNet & SatNet::operator=(const SatNet & rhs){
     clear();
 
     // Perform a deep copy of the rhs tree
-    m_root = deepCopy(rhs.m_root);
+    if (m_pool != nullptr) {
+        m_root = deepCopyParallel(rhs.m_root);
+    } else {
+        m_root = deepCopy(rhs.m_root);
+    }
+    m_nodes = rhs.m_nodes;
+    m_tombstones = rhs.m_tombstones;
+    m_present = rhs.m_present;
+    if (m_tombstones > 0 && !m_lazy) {
+        compact();
+    }
+    if (m_tracer != nullptr) {
+        traceSnapshot(m_root);
+        traceTombstones(m_root);
+    }
 
     return *this;
 }
 
-int SatNet::countSatellitesHelper(Sat* node, INCLIN degree) const {
+// records the tree in preorder, each node with its rank relative to its left child
+void SatNet::traceSnapshot(const Sat* node) {
     if (node == nullptr) {
-        return 0;
+        return;
     }
+    int rank = node->getHeight() - rankOf(node->getLeft());
+    m_tracer->record(T_SNAPSHOT, node->getID(),
+                     (unsigned char)(node->getAlt() | (node->getInclin() << 2) | (node->getState() << 4) | (rank << 6)));
+    traceSnapshot(node->getLeft());
+    traceSnapshot(node->getRight());
+}
 
-    int count = 0;
+// a snapshot restores every node live, so copied tombstones are removed again
+void SatNet::traceTombstones(const Sat* node) {
+    if (node == nullptr) {
+        return;
+    }
+    traceTombstones(node->getLeft());
+    if (node->isDeleted()) {
+        m_tracer->record(T_REMOVE, node->getID());
+    }
+    traceTombstones(node->getRight());
+}
+
+// replaces the tree with the traced snapshot, ranks are taken from the heights
+void SatNet::restoreSnapshot(const vector<Sat>& preorder) {
+    clear();
+    size_t next = 0;
+    m_root = restoreHelper(preorder, next, LLONG_MIN, LLONG_MAX);
+    m_nodes = (int)next;
+}
 
-    if (node->getInclin() == degree) {
-        //  increment count
-        count++;
+Sat* SatNet::restoreHelper(const vector<Sat>& preorder, size_t& next, long long low, long long high) {
+    if (next == preorder.size() || preorder[next].getID() <= low || preorder[next].getID() >= high) {
+        return nullptr;
     }
+    Sat* node = new Sat(preorder[next++]);
+    node->setDeleted(false);
+    m_present.set(node->getID());
+    node->setLeft(restoreHelper(preorder, next, low, node->getID()));
+    node->setRight(restoreHelper(preorder, next, node->getID(), high));
+    return node;
+}
 
-    // count satellites in subtrees
-    count += countSatellitesHelper(node->getLeft(), degree);
-    count += countSatellitesHelper(node->getRight(), degree);
+int SatNet::countSatellites(INCLIN degree) const{
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_COUNT, 0, (unsigned char)degree);
+    }
+    switch (degree) {
+        case I48: return count<I48>();
+        case I53: return count<I53>();
+        case I70: return count<I70>();
+        case I97: return count<I97>();
+        default: return 0;
+    }
+}
 
+int SatNet::countRange(int low, int high) const {
+    if (low > high) {
+        return 0;
+    }
+    int count = m_present.count(low, high);
+    if (low < MINID || high > MAXID) {
+        count += countOutside(m_root, low, high);
+    }
     return count;
 }
-int SatNet::countSatellites(INCLIN degree) const{
-    return countSatellitesHelper(m_root, degree);
 
+// live satellites in low..high whose IDs the bitmap does not cover
+int SatNet::countOutside(const Sat* node, int low, int high) const {
+    if (node == nullptr) {
+        return 0;
+    }
+    int id = node->getID();
+    int count = (id >= low && id <= high && !SatBitmap::inRange(id) && !node->isDeleted()) ? 1 : 0;
+    // a subtree is only visited if it can hold IDs below MINID or above MAXID inside low..high
+    if (id > low && (low < MINID || (high > MAXID && id > MAXID))) {
+        count += countOutside(node->getLeft(), low, high);
+    }
+    if (id < high && (high > MAXID || (low < MINID && id < MINID))) {
+        count += countOutside(node->getRight(), low, high);
+    }
+    return count;
+}
+
+void SatBitmap::clear() {
+    std::fill(m_words.begin(), m_words.end(), 0ULL);
+}
+
+int SatBitmap::count(int low, int high) const {
+    low = max(low, MINID) - MINID;
+    high = min(high, MAXID) - MINID;
+    if (low > high) {
+        return 0;
+    }
+    int first = low >> 6;
+    int last = high >> 6;
+    unsigned long long lowMask = ~0ULL << (low & 63);
+    unsigned long long highMask = ~0ULL >> (63 - (high & 63));
+    if (first == last) {
+        return __builtin_popcountll(m_words[first] & lowMask & highMask);
+    }
+    int count = __builtin_popcountll(m_words[first] & lowMask) + __builtin_popcountll(m_words[last] & highMask);
+    for (int i = first + 1; i < last; i++) {
+        count += __builtin_popcountll(m_words[i]);
+    }
+    return count;
+}
+
+void SatNet::setTaskPool(TaskPool* pool) {
+    m_pool = pool;
+}
+
+Sat* SatNet::buildHelper(const vector<Sat>& satellites, int low, int high) {
+    if (low > high) {
+        return nullptr;
+    }
+
+    int mid = low + (high - low) / 2;
+    Sat* node = new Sat(satellites[mid]);
+    node->setDeleted(false);
+    Sat* left = nullptr;
+    if (m_pool != nullptr && high - low + 1 > PARALLEL_CUTOFF_SIZE) {
+        TaskGroup group(m_pool);
+        group.run([this, &satellites, &left, low, mid] {left = buildHelper(satellites, low, mid - 1);});
+        node->setRight(buildHelper(satellites, mid + 1, high));
+        group.wait();
+    } else {
+        left = buildHelper(satellites, low, mid - 1);
+        node->setRight(buildHelper(satellites, mid + 1, high));
+    }
+    node->setLeft(left);
+
+    setBuiltRank(node);
+    return node;
+}
+
+void SatNet::buildFromSorted(const vector<Sat>& satellites) {
+    clear();
+    m_root = buildHelper(satellites, 0, (int)satellites.size() - 1);
+    m_nodes = (int)satellites.size();
+    for (size_t i = 0; i < satellites.size(); i++) {
+        m_present.set(satellites[i].getID());
+    }
+    if (m_tracer != nullptr) {
+        traceSnapshot(m_root);
+    }
+}
+
+void SatNet::setLazyRemoval(bool lazy, double ratio) {
+    m_lazy = lazy;
+    m_tombstoneRatio = ratio;
+    if (!m_lazy && m_tombstones > 0) {
+        compact();
+    }
+}
+
+// in-order list of the nodes that stay, everything else is freed
+void SatNet::collectLive(Sat* node, vector<Sat*>& live, bool dropDeorbited) {
+    if (node == nullptr) {
+        return;
+    }
+    collectLive(node->getLeft(), live, dropDeorbited);
+    Sat* right = node->getRight();
+    if (node->isDeleted() || (dropDeorbited && node->getState() == DEORBITED)) {
+        if (!node->isDeleted()) {
+            publish(SatChange(REMOVED, node->getID()));
+        }
+        invalidate(node->getID());
+        m_present.reset(node->getID());
+        delete node;
+    } else {
+        live.push_back(node);
+    }
+    collectLive(right, live, dropDeorbited);
+}
+
+// links already allocated nodes into a balanced tree, nodes keep their addresses
+Sat* SatNet::relinkHelper(const vector<Sat*>& nodes, int low, int high) {
+    if (low > high) {
+        return nullptr;
+    }
+    int mid = low + (high - low) / 2;
+    Sat* node = nodes[mid];
+    node->setLeft(relinkHelper(nodes, low, mid - 1));
+    node->setRight(relinkHelper(nodes, mid + 1, high));
+
+    setBuiltRank(node);
+    return node;
+}
+
+void SatNet::compact() {
+    m_version++;
+    vector<Sat*> live;
+    live.reserve(m_nodes - m_tombstones);
+    collectLive(m_root, live, false);
+    m_root = relinkHelper(live, 0, (int)live.size() - 1);
+    m_nodes = (int)live.size();
+    m_tombstones = 0;
+}
+
+void SatNet::subscribe(ChangeFeed* feed) {
+    m_feeds.push_back(feed);
+}
+
+void SatNet::unsubscribe(ChangeFeed* feed) {
+    m_feeds.erase(std::remove(m_feeds.begin(), m_feeds.end(), feed), m_feeds.end());
+}
+
+void SatNet::publish(const SatChange& change) {
+    for (size_t i = 0; i < m_feeds.size(); i++) {
+        m_feeds[i]->publish(change);
+    }
+}
+
+void SatNet::setTracer(TraceRecorder* tracer) {
+    m_tracer = tracer;
+}
+
+void SatNet::enableCache(int entries) {
+    // clamped first, 1 << bits would overflow past 2^30
+    if (entries > MAX_CACHE_ENTRIES) {
+        entries = MAX_CACHE_ENTRIES;
+    }
+    int bits = 0;
+    while (entries > 0 && (1 << bits) < entries) {
+        bits++;
+    }
+    m_cache.assign(entries > 0 ? (size_t)1 << bits : 0, SatCacheEntry());
+    m_cacheShift = 32 - bits;
+    m_cacheHits = 0;
+    m_cacheMisses = 0;
+}
+
+Sat* SatNet::cachedLookup(int id) const {
+    // Fibonacci hashing spreads runs of consecutive IDs over the slots
+    unsigned int slot = (m_cacheShift >= 32) ? 0 : ((unsigned int)id * 2654435769u) >> m_cacheShift;
+    SatCacheEntry& entry = m_cache[slot];
+    if (entry.m_node != nullptr && entry.m_id == id) {
+        m_cacheHits++;
+        return entry.m_node;
+    }
+
+    m_cacheMisses++;
+    Sat* node = m_root;
+    while (node != nullptr && node->getID() != id) {
+        node = (id < node->getID()) ? node->getLeft() : node->getRight();
+    }
+    if (node != nullptr && !node->isDeleted()) {
+        entry.m_id = id;
+        entry.m_node = node;
+    }
+    return node;
+}
+
+// drops the entry of an ID whose node is freed or given another payload
+void SatNet::invalidate(int id) {
+    if (m_cache.empty()) {
+        return;
+    }
+    unsigned int slot = (m_cacheShift >= 32) ? 0 : ((unsigned int)id * 2654435769u) >> m_cacheShift;
+    if (m_cache[slot].m_id == id) {
+        m_cache[slot].m_node = nullptr;
+    }
+}
+
+void SatNet::flushCache() {
+    for (size_t i = 0; i < m_cache.size(); i++) {
+        m_cache[i].m_node = nullptr;
+    }
+}
+
+SatNet::Cursor::Cursor(SatNet& network) {
+    m_network = &network;
+    m_version = network.m_version;
+}
+
+// drops a path that an outside change may have broken
+void SatNet::Cursor::sync() {
+    if (m_version != m_network->m_version) {
+        m_path.clear();
+        m_version = m_network->m_version;
+    }
+}
+
+void SatNet::Cursor::push(Sat* child) {
+    PathEntry& top = m_path.back();
+    PathEntry entry;
+    entry.m_node = child;
+    if (child->getID() < top.m_node->getID()) {
+        entry.m_low = top.m_low;
+        entry.m_high = top.m_node->getID();
+    } else {
+        entry.m_low = top.m_node->getID();
+        entry.m_high = top.m_high;
+    }
+    m_path.push_back(entry);
+}
+
+bool SatNet::Cursor::seek(int id) {
+    sync();
+    if (m_path.empty()) {
+        if (m_network->m_root == nullptr) {
+            return false;
+        }
+        PathEntry root;
+        root.m_node = m_network->m_root;
+        root.m_low = LLONG_MIN;
+        root.m_high = LLONG_MAX;
+        m_path.push_back(root);
+    }
+
+    // climb only until the subtree on top can hold id
+    while (m_path.size() > 1 && !(m_path.back().m_low < id && id < m_path.back().m_high)) {
+        m_path.pop_back();
+    }
+    while (true) {
+        Sat* node = m_path.back().m_node;
+        if (id == node->getID()) {
+            return !node->isDeleted();
+        }
+        Sat* child = (id < node->getID()) ? node->getLeft() : node->getRight();
+        if (child == nullptr) {
+            return false;
+        }
+        push(child);
+    }
+}
+
+void SatNet::Cursor::step(bool forward) {
+    Sat* node = m_path.back().m_node;
+    Sat* down = forward ? node->getRight() : node->getLeft();
+    if (down != nullptr) {
+        // leftmost node of the right subtree, or rightmost of the left one
+        push(down);
+        while ((forward ? m_path.back().m_node->getLeft() : m_path.back().m_node->getRight()) != nullptr) {
+            push(forward ? m_path.back().m_node->getLeft() : m_path.back().m_node->getRight());
+        }
+        return;
+    }
+    // climb until we leave a subtree from the side we are moving away from
+    while (true) {
+        Sat* child = m_path.back().m_node;
+        m_path.pop_back();
+        if (m_path.empty()) {
+            return;
+        }
+        Sat* parent = m_path.back().m_node;
+        if ((forward ? parent->getLeft() : parent->getRight()) == child) {
+            return;
+        }
+    }
+}
+
+bool SatNet::Cursor::next() {
+    sync();
+    do {
+        if (m_path.empty()) {
+            return false;
+        }
+        step(true);
+    } while (!m_path.empty() && m_path.back().m_node->isDeleted());
+    return !m_path.empty();
+}
+
+bool SatNet::Cursor::prev() {
+    sync();
+    do {
+        if (m_path.empty()) {
+            return false;
+        }
+        step(false);
+    } while (!m_path.empty() && m_path.back().m_node->isDeleted());
+    return !m_path.empty();
+}
+
+bool SatNet::Cursor::insertAfter(const Sat& satellite) {
+    SatNet& network = *m_network;
+    int id = satellite.getID();
+    if (network.m_tracer != nullptr) {
+        network.m_tracer->record(T_INSERT, id,
+                                 (unsigned char)(satellite.getAlt() | (satellite.getInclin() << 2) | (satellite.getState() << 4)));
+    }
+
+    seek(id);
+    if (!m_path.empty() && m_path.back().m_node->getID() == id) {
+        Sat* node = m_path.back().m_node;
+        if (!node->isDeleted()) {
+            return false;
+        }
+        // the ID was lazily removed, bring the node back with the new payload
+        node->setAlt(satellite.getAlt());
+        node->setInclin(satellite.getInclin());
+        node->setState(satellite.getState());
+        node->setDeleted(false);
+        network.m_tombstones--;
+        network.m_present.set(id);
+        network.publish(SatChange(INSERTED, id, satellite.getAlt(), satellite.getInclin(), satellite.getState()));
+        return true;
+    }
+
+    Sat* fresh = new Sat(satellite.getID(), satellite.getAlt(), satellite.getInclin(), satellite.getState());
+    fresh->setHeight(1);
+    network.m_nodes++;
+    network.m_present.set(id);
+    network.m_version++;
+    m_version = network.m_version;
+    network.publish(SatChange(INSERTED, id, satellite.getAlt(), satellite.getInclin(), satellite.getState()));
+    if (m_path.empty()) {
+        network.m_root = fresh;
+        PathEntry root;
+        root.m_node = fresh;
+        root.m_low = LLONG_MIN;
+        root.m_high = LLONG_MAX;
+        m_path.push_back(root);
+        return true;
+    }
+    Sat* parent = m_path.back().m_node;
+    if (id < parent->getID()) {
+        parent->setLeft(fresh);
+    } else {
+        parent->setRight(fresh);
+    }
+    push(fresh);
+
+    // walk back up only while ranks change, one fix with rotations at most.
+    // A red-black violation is seen two levels above a recolored node, so the
+    // walk stops after two unchanged levels
+    int unchanged = 0;
+    for (int i = (int)m_path.size() - 2; i >= 0; i--) {
+        Sat* node = m_path[i].m_node;
+        int oldHeight = node->getHeight();
+        Sat* top = network.fixInsert(node);
+        if (top != node) {
+            relink(i, node, top);
+            // the rotation restored the old rank of the subtree, so nothing
+            // above changes; retake the path below it down to the new node
+            m_path.resize(i + 1);
+            m_path[i].m_node = top;
+            while (m_path.back().m_node != fresh) {
+                Sat* below = m_path.back().m_node;
+                push((id < below->getID()) ? below->getLeft() : below->getRight());
+            }
+            break;
+        }
+        if (node->getHeight() != oldHeight) {
+            unchanged = 0;
+        } else if (++unchanged == 2) {
+            break;
+        }
+    }
+    return true;
+}
+
+// points the parent of path entry index, or the root, at top instead of node
+void SatNet::Cursor::relink(int index, Sat* node, Sat* top) {
+    if (index == 0) {
+        m_network->m_root = top;
+    } else if (m_path[index - 1].m_node->getLeft() == node) {
+        m_path[index - 1].m_node->setLeft(top);
+    } else {
+        m_path[index - 1].m_node->setRight(top);
+    }
+}
+
+bool SatNet::Cursor::remove() {
+    sync();
+    if (m_path.empty() || m_path.back().m_node->isDeleted()) {
+        return false;
+    }
+    SatNet& network = *m_network;
+    Sat* doomed = m_path.back().m_node;
+    int id = doomed->getID();
+    if (network.m_tracer != nullptr) {
+        network.m_tracer->record(T_REMOVE, id);
+    }
+    if (network.m_lazy) {
+        // lazy removal only marks the node, no rotations
+        doomed->setDeleted(true);
+        network.m_present.reset(id);
+        network.m_tombstones++;
+        network.publish(SatChange(REMOVED, id));
+        if (network.m_tombstones > network.m_tombstoneRatio * network.m_nodes) {
+            network.compact();
+        }
+        return true;
+    }
+
+    Sat* replacement;
+    if (doomed->getLeft() == nullptr || doomed->getRight() == nullptr) {
+        replacement = (doomed->getLeft() != nullptr) ? doomed->getLeft() : doomed->getRight();
+    } else {
+        // the successor is unlinked from the right subtree and takes the place of the node
+        Sat* successor = nullptr;
+        Sat* right = network.detachMin(doomed->getRight(), successor);
+        successor->setLeft(doomed->getLeft());
+        successor->setRight(right);
+        successor->setHeight(doomed->getHeight());
+        replacement = network.fixRemove(successor);
+    }
+    relink((int)m_path.size() - 1, doomed, replacement);
+    m_path.pop_back();
+    network.invalidate(id);
+    network.m_present.reset(id);
+    delete doomed;
+    network.m_nodes--;
+    network.m_version++;
+    m_version = network.m_version;
+    network.publish(SatChange(REMOVED, id));
+
+    // a removal can need a fix on every level up to the root; a rotation
+    // leaves the path below it stale, so the cursor keeps only the part above
+    for (int i = (int)m_path.size() - 1; i >= 0; i--) {
+        Sat* node = m_path[i].m_node;
+        Sat* top = network.fixRemove(node);
+        if (top != node) {
+            relink(i, node, top);
+            m_path.resize(i + 1);
+            m_path[i].m_node = top;
+        }
+    }
+    return true;
 }
+
+const Sat* SatNet::getHandle(int id) const {
+    if (SatBitmap::inRange(id) && !m_present.test(id)) {
+        return nullptr;
+    }
+    if (!m_cache.empty()) {
+        Sat* node = cachedLookup(id);
+        return (node != nullptr && !node->isDeleted()) ? node : nullptr;
+    }
+    Sat* node = m_root;
+    while (node != nullptr && node->getID() != id) {
+        node = (id < node->getID()) ? node->getLeft() : node->getRight();
+    }
+    return (node != nullptr && !node->isDeleted()) ? node : nullptr;
+}
+
+bool SatNet::setState(const Sat* handle, STATE state) {
+    if (handle == nullptr || handle->isDeleted()) {
+        return false;
+    }
+    if (m_tracer != nullptr) {
+        m_tracer->record(T_SETSTATE, handle->getID(), (unsigned char)state);
+    }
+    // the tree owns the node, the handle is only const to keep callers off its links
+    Sat* node = const_cast<Sat*>(handle);
+    node->setState(state);
+    publish(SatChange(STATECHANGED, node->getID(), node->getAlt(), node->getInclin(), state));
+    return true;
+}
\ No newline at end of file
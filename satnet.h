@@ -6,20 +6,55 @@
 #ifndef SATNET_H
 #define SATNET_H
 #include <iostream>
+#include <climits>
+#include <vector>
+#include <string_view>
+#include <iterator>
+#include <type_traits>
+#include "taskpool.h"
 using namespace std;
 class Grader;
 class Tester;
 class SatNet;
+class ChangeFeed;
+class SatChange;
+class TraceRecorder;
+class TraceReplayer;
 const int MINID = 10000;
 const int MAXID = 99999;
 enum STATE {ACTIVE, DEORBITED, DECAYING};
 enum ALT {MI208, MI215, MI340, MI350};  // altitude in miles
 enum INCLIN {I48, I53, I70, I97};       // inclination in degrees
+// names and values indexed by the enums
+constexpr string_view STATE_NAMES[3] = {"Active", "Deorbited", "Decaying"};
+constexpr string_view ALT_NAMES[4] = {"208 miles", "215 miles", "340 miles", "350 miles"};
+constexpr string_view INCLIN_NAMES[4] = {"48 degrees", "53 degrees", "70 degrees", "97 degrees"};
+constexpr int ALT_MILES[4] = {208, 215, 340, 350};
+constexpr int INCLIN_DEGREES[4] = {48, 53, 70, 97};
 #define DEFAULT_HEIGHT 0
 #define DEFAULT_ID 0
 #define DEFAULT_INCLIN I48
 #define DEFAULT_ALT MI208
 #define DEFAULT_STATE ACTIVE
+#define PARALLEL_CUTOFF_HEIGHT 12   // subtrees this short are copied or cleared sequentially
+#define PARALLEL_CUTOFF_SIZE 4096   // runs this small are built sequentially
+#define DEFAULT_TOMBSTONE_RATIO 0.25 // lazy removal compacts once this fraction of nodes are tombstones
+#define MAX_CACHE_ENTRIES (1 << 20)  // larger cache requests are clamped, well above MAXID - MINID
+
+// balancing policy of SatNet, picked at compile time. Every policy keeps a
+// rank in the node's height field, with 1 for a leaf and 0 for a missing child:
+// AVL ranks are subtree heights, red-black ranks are black heights with a red
+// node ranked like its parent, and weak AVL allows rank differences of 1 or 2
+// with leaves at rank 1, which makes rotations O(1) amortized
+#define BALANCE_AVL 0
+#define BALANCE_REDBLACK 1
+#define BALANCE_WAVL 2
+#ifndef SATNET_BALANCE
+#define SATNET_BALANCE BALANCE_AVL
+#endif
+#if SATNET_BALANCE != BALANCE_AVL && SATNET_BALANCE != BALANCE_REDBLACK && SATNET_BALANCE != BALANCE_WAVL
+#error "SATNET_BALANCE must be BALANCE_AVL, BALANCE_REDBLACK or BALANCE_WAVL"
+#endif
 class Sat{
 public:
     friend class SatNet;
@@ -30,6 +65,7 @@ public:
         m_left = nullptr;
         m_right = nullptr;
         m_height = DEFAULT_HEIGHT;
+        m_deleted = false;
     }
     Sat(){
         m_id = DEFAULT_ID;
@@ -39,46 +75,24 @@ public:
         m_left = nullptr;
         m_right = nullptr;
         m_height = DEFAULT_HEIGHT;
+        m_deleted = false;
     }
     int getID() const {return m_id;}
     STATE getState() const {return m_state;}
-    string getStateStr() const {
-        string text = "";
-        switch (m_state){
-            case ACTIVE:text = "Active";break;
-            case DEORBITED:text = "Deorbited";break;
-            case DECAYING:text = "Decaying";break;
-            default:text = "UNKNOWN";break;
-        }
-        return text;
-    }
+    string_view getStateStr() const {return ((unsigned)m_state < size(STATE_NAMES)) ? STATE_NAMES[m_state] : "UNKNOWN";}
     INCLIN getInclin() const {return m_inclin;}
-    string getInclinStr() const {
-        string text = "";
-        switch (m_inclin){
-            case I48:text = "48 degrees";break;
-            case I53:text = "53 degrees";break;
-            case I70:text = "70 degrees";break;
-            case I97:text = "97 degrees";break;
-            default:text = "UNKNOWN";break;
-        }
-        return text;
-    }
+    string_view getInclinStr() const {return ((unsigned)m_inclin < size(INCLIN_NAMES)) ? INCLIN_NAMES[m_inclin] : "UNKNOWN";}
+    int getInclinDegrees() const {return ((unsigned)m_inclin < size(INCLIN_DEGREES)) ? INCLIN_DEGREES[m_inclin] : 0;}
     ALT getAlt() const {return m_altitude;}
-    string getAltStr() const {
-        string text = "";
-        switch (m_altitude){
-            case MI208:text = "208 miles";break;
-            case MI215:text = "215 miles";break;
-            case MI340:text = "340 miles";break;
-            case MI350:text = "350 miles";break;
-            default:text = "UNKNOWN";break;
-        }
-        return text;
-    }
+    string_view getAltStr() const {return ((unsigned)m_altitude < size(ALT_NAMES)) ? ALT_NAMES[m_altitude] : "UNKNOWN";}
+    int getAltMiles() const {return ((unsigned)m_altitude < size(ALT_MILES)) ? ALT_MILES[m_altitude] : 0;}
+    // true when the attribute of Value's enum type equals Value, e.g. is<DECAYING>()
+    template <auto Value>
+    bool is() const;
     int getHeight() const {return m_height;}
     Sat* getLeft() const {return m_left;}
     Sat* getRight() const {return m_right;}
+    bool isDeleted() const {return m_deleted;}
     void setID(const int id){m_id=id;}
     void setState(STATE state){m_state=state;}
     void setInclin(INCLIN degree){m_inclin=degree;}
@@ -86,6 +100,7 @@ public:
     void setHeight(int height){m_height=height;}
     void setLeft(Sat* left){m_left=left;}
     void setRight(Sat* right){m_right=right;}
+    void setDeleted(bool deleted){m_deleted=deleted;}
 private:
     int m_id;
     ALT m_altitude;
@@ -93,12 +108,34 @@ private:
     STATE m_state;
     Sat* m_left;    //the pointer to the left child in the BST
     Sat* m_right;   //the pointer to the right child in the BST
-    int m_height;   //the height of node in the BST
+    int m_height;   //the rank of node in the BST, its height under AVL
+    bool m_deleted; //tombstone left by a lazy removal
+};
+// one slot of the hot-ID lookup cache
+class SatCacheEntry{
+public:
+    int m_id = 0;
+    Sat* m_node = nullptr;  // nullptr when the slot is empty
+};
+// one presence bit per ID in MINID..MAXID, about 11 KB, so membership
+// tests stay in cache; IDs outside the range are never marked
+class SatBitmap{
+public:
+    SatBitmap() : m_words((MAXID - MINID + 64) / 64, 0){}
+    static bool inRange(int id){return id >= MINID && id <= MAXID;}
+    bool test(int id) const{return (m_words[(id - MINID) >> 6] >> ((id - MINID) & 63)) & 1;}
+    void set(int id){if (inRange(id)) m_words[(id - MINID) >> 6] |= 1ULL << ((id - MINID) & 63);}
+    void reset(int id){if (inRange(id)) m_words[(id - MINID) >> 6] &= ~(1ULL << ((id - MINID) & 63));}
+    void clear();
+    int count(int low, int high) const;   // marked IDs in low..high, clamped to the range
+private:
+    vector<unsigned long long> m_words;
 };
 class SatNet{
 public:
     friend class Grader;
     friend class Tester;
+    friend class TraceReplayer;
     SatNet();
     ~SatNet();
     // overloaded assignment operator
@@ -109,12 +146,112 @@ public:
     void dumpTree() const;
     void listSatellites() const;
     bool setState(int id, STATE state);
+    // a handle keeps pointing at the same satellite until that satellite is
+    // removed (or compacted away after a lazy removal), clear() and operator=
+    // drop every handle; nullptr if the satellite is not in the tree
+    const Sat* getHandle(int id) const;
+    // updates the satellite behind a handle without any lookup
+    bool setState(const Sat* handle, STATE state);
+    // applies changes sorted by strictly ascending ID in a single descent,
+    // returns how many of the satellites were found
+    int setStates(const vector<pair<int, STATE>>& changes);
     void removeDeorbited();//removes all deorbited satellites from the tree
     bool findSatellite(int id) const;//returns true if the satellite is in tree
     int countSatellites(INCLIN degree) const;
+    // satellites whose attribute of Value's enum type equals Value, as in
+    // count<I53>() or count<DECAYING>(), with the filter fixed at compile
+    // time; only countSatellites is recorded by the tracer
+    template <auto Value>
+    int count() const;
+    int size() const {return m_nodes - m_tombstones;}  // satellites in the tree, tombstones excluded
+    // satellites with IDs in low..high, popcounted from the presence bitmap
+    // for the part inside MINID..MAXID
+    int countRange(int low, int high) const;
+    // uses the pool to copy, clear and build by subtree, nullptr runs sequentially
+    void setTaskPool(TaskPool* pool);
+    // replaces the tree with a balanced one built from satellites sorted by strictly ascending ID
+    void buildFromSorted(const vector<Sat>& satellites);
+    // folds every satellite into a T, splitting the tree by subtree over the task pool.
+    // fold(T&, const Sat&) adds one satellite and combine(T&, T&) appends the partial
+    // result of the subtree that follows in ID order, so with an associative combine the
+    // result equals a sequential in-order fold. Both are called from several threads.
+    template <class T, class Fold, class Combine>
+    T parallelReduce(const T& identity, Fold fold, Combine combine) const;
+    // satellites matching the predicate, in ID order unless ordered is false
+    template <class Predicate>
+    vector<const Sat*> collectSatellites(Predicate predicate, bool ordered = true) const;
+    // in lazy mode remove() only marks a tombstone, and the tree is rebuilt in one
+    // pass once more than ratio of its nodes are tombstones. Turning it off compacts.
+    void setLazyRemoval(bool lazy, double ratio = DEFAULT_TOMBSTONE_RATIO);
+    void compact();     // drops every tombstone and rebalances in linear time
+    int getTombstones() const {return m_tombstones;}
+    // every mutation is published to the subscribed feeds, clear() and
+    // operator= publish a single RESET; unsubscribe before destroying a feed
+    void subscribe(ChangeFeed* feed);
+    void unsubscribe(ChangeFeed* feed);
+    // records every public call, operator= and buildFromSorted as a clear and a
+    // snapshot of the resulting tree; nullptr stops
+    void setTracer(TraceRecorder* tracer);
+    // direct-mapped id -> node cache in front of the tree for findSatellite and
+    // setState, entries is rounded up to a power of two and clamped to
+    // MAX_CACHE_ENTRIES, 0 turns it off
+    void enableCache(int entries);
+    long long getCacheHits() const {return m_cacheHits;}
+    long long getCacheMisses() const {return m_cacheMisses;}
+    long long getRotations() const {return m_rotations;}   // single rotations since construction
+
+    // a position in the tree that keeps its root-to-node path, so seeking to
+    // or inserting a nearby ID only climbs as far as the subtree holding it.
+    // Changes made through anything but this cursor make it restart from the root.
+    class Cursor{
+    public:
+        friend class Tester;
+        explicit Cursor(SatNet& network);
+        // moves to id, or to the satellite next to where id would be; true if id is in the tree
+        bool seek(int id);
+        bool next();    // moves to the next satellite in ID order, false and invalid at the end
+        bool prev();    // moves to the previous satellite in ID order, false and invalid at the start
+        bool valid() const {return !m_path.empty();}
+        const Sat* get() const {return m_path.empty() ? nullptr : m_path.back().m_node;}
+        // inserts the satellite, cheapest when its ID is just after the current one
+        // as in a launch batch, and moves to it; false for a duplicate ID
+        bool insertAfter(const Sat& satellite);
+        // removes the satellite the cursor is on, relinking like SatNet::remove,
+        // and moves to one of its ancestors; false when not on a live satellite
+        bool remove();
+    private:
+        class PathEntry{
+        public:
+            Sat* m_node;
+            long long m_low;    // every ID under m_node is greater than m_low
+            long long m_high;   // and less than m_high
+        };
+        SatNet* m_network;
+        vector<PathEntry> m_path;
+        long long m_version;    // the tree version the path was taken from
+
+        void sync();
+        void push(Sat* child);
+        void step(bool forward);
+        void relink(int index, Sat* node, Sat* top);
+    };
 
 private:
     Sat* m_root;    //the root of the BST
+    TaskPool* m_pool;   //the pool for parallel copy, clear and build, not owned
+    int m_nodes;        //nodes in the tree, tombstones included
+    int m_tombstones;   //nodes marked deleted but not yet unlinked
+    bool m_lazy;        //remove() leaves tombstones
+    double m_tombstoneRatio;
+    vector<ChangeFeed*> m_feeds;    //subscribers, not owned
+    TraceRecorder* m_tracer;        //the call recorder, not owned
+    mutable vector<SatCacheEntry> m_cache;  //empty when the cache is off
+    int m_cacheShift;               //hash shift, 32 - log2 of the cache size
+    mutable long long m_cacheHits;
+    mutable long long m_cacheMisses;
+    long long m_version;            //bumped on every structural change, checked by cursors
+    SatBitmap m_present;            //live satellites in MINID..MAXID, answers misses without a descent
+    long long m_rotations;          //single rotations done by the balancing policy
 
     // ***************************************************
     // Any private helper functions must be delared here!
@@ -125,16 +262,105 @@ private:
     Sat *  insertHelper(Sat* node, const Sat& satellite);
     Sat * rotateRight(Sat * node);
     Sat * rotateLeft(Sat * node);
-    Sat * findMin(Sat * node);
+    Sat * rebalance(Sat * node);
+    Sat * fixInsert(Sat * node);
+    Sat * fixRemove(Sat * node);
+    void setBuiltRank(Sat * node);
+    Sat * detachMin(Sat * node, Sat *& minNode);
     Sat * removeHelper(Sat *node, int id);
     int calculateBalance(Sat * node);
-    void listSatellitesHelper(Sat* node) const;
     bool setStateHelper(Sat* node, int id, STATE state);
-   void removeDeorbitedHelper(Sat*& node);
+    int setStatesHelper(Sat* node, const pair<int, STATE>* first, const pair<int, STATE>* last);
    bool findSatelliteHelper(Sat* node, int id) const;
 
     Sat* deepCopy(const Sat* node);
-    int countSatellitesHelper(Sat* node, INCLIN degree) const;
+    Sat* deepCopyParallel(const Sat* node);
+    void clearParallel(Sat* node);
+    Sat* buildHelper(const vector<Sat>& satellites, int low, int high);
+    void collectLive(Sat* node, vector<Sat*>& live, bool dropDeorbited);
+    Sat* relinkHelper(const vector<Sat*>& nodes, int low, int high);
+    void publish(const SatChange& change);
+    void traceSnapshot(const Sat* node);
+    void traceTombstones(const Sat* node);
+    void restoreSnapshot(const vector<Sat>& preorder);
+    Sat* restoreHelper(const vector<Sat>& preorder, size_t& next, long long low, long long high);
+    Sat* cachedLookup(int id) const;
+    void invalidate(int id);
+    void flushCache();
+    int countOutside(const Sat* node, int low, int high) const;
+    template <class T, class Fold, class Combine>
+    void reduceHelper(const Sat* node, T& acc, const T& identity, Fold& fold, Combine& combine) const;
 
 };
+
+template <auto Value>
+bool Sat::is() const {
+    if constexpr (is_same<decltype(Value), STATE>::value) {
+        return m_state == Value;
+    } else if constexpr (is_same<decltype(Value), ALT>::value) {
+        return m_altitude == Value;
+    } else {
+        static_assert(is_same<decltype(Value), INCLIN>::value, "Value must be a STATE, ALT or INCLIN");
+        return m_inclin == Value;
+    }
+}
+
+template <auto Value>
+int SatNet::count() const {
+    return parallelReduce(0,
+        [](int& count, const Sat& satellite) {count += satellite.is<Value>();},
+        [](int& count, int& right) {count += right;});
+}
+
+template <class T, class Fold, class Combine>
+T SatNet::parallelReduce(const T& identity, Fold fold, Combine combine) const {
+    T acc = identity;
+    reduceHelper(m_root, acc, identity, fold, combine);
+    return acc;
+}
+
+template <class T, class Fold, class Combine>
+void SatNet::reduceHelper(const Sat* node, T& acc, const T& identity, Fold& fold, Combine& combine) const {
+    if (node == nullptr) {
+        return;
+    }
+    if (m_pool == nullptr || node->getHeight() <= PARALLEL_CUTOFF_HEIGHT) {
+        reduceHelper(node->getLeft(), acc, identity, fold, combine);
+        if (!node->isDeleted()) {
+            fold(acc, *node);
+        }
+        reduceHelper(node->getRight(), acc, identity, fold, combine);
+        return;
+    }
+
+    // the right subtree gets its own accumulator and may be stolen by another worker
+    T right = identity;
+    TaskGroup group(m_pool);
+    group.run([this, node, &right, &identity, &fold, &combine] {
+        reduceHelper(node->getRight(), right, identity, fold, combine);
+    });
+    reduceHelper(node->getLeft(), acc, identity, fold, combine);
+    if (!node->isDeleted()) {
+        fold(acc, *node);
+    }
+    group.wait();
+    combine(acc, right);
+}
+
+template <class Predicate>
+vector<const Sat*> SatNet::collectSatellites(Predicate predicate, bool ordered) const {
+    return parallelReduce(vector<const Sat*>(),
+        [&predicate](vector<const Sat*>& acc, const Sat& satellite) {
+            if (predicate(satellite)) {
+                acc.push_back(&satellite);
+            }
+        },
+        [ordered](vector<const Sat*>& acc, vector<const Sat*>& right) {
+            // without ordering the smaller part is always the one copied
+            if (!ordered && acc.size() < right.size()) {
+                acc.swap(right);
+            }
+            acc.insert(acc.end(), right.begin(), right.end());
+        });
+}
 #endif
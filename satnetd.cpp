@@ -0,0 +1,328 @@
+//
+// Serves one SatNet to local processes over a Unix domain socket.
+// usage: satnetd <socket path> [--fill]
+//
+// A single thread owns the tree and runs a level-triggered epoll loop.
+// Every wakeup reads whatever complete frames the ready clients have
+// sent, so pipelined requests from all of them form one batch. The batch
+// is cut into runs of the same op; each run is stable sorted by ID and
+// served in one ascending cursor pass, which keeps the order of requests
+// for the same ID. Responses go back in request order per connection.
+// --fill starts with every ID from MINID to MAXID as an active satellite.
+//
+
+#include "satnet.h"
+#include "satproto.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 64
+#define READ_LIMIT 65536        // bytes taken from one client per wakeup
+#define OUTPUT_LIMIT (1 << 20)  // a client with this much unsent output is not read
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void onSignal(int){
+    g_stop = 1;
+}
+
+class Connection{
+public:
+    int m_fd = -1;
+    vector<unsigned char> m_in;     // a partial frame left from the last read
+    vector<unsigned char> m_out;
+    size_t m_sent = 0;              // bytes of m_out already written
+    bool m_eof = false;             // the client finished sending
+    bool m_failed = false;
+    unsigned int m_events = 0;      // what epoll currently watches
+};
+
+class Pending{
+public:
+    Connection* m_conn;
+    ProtoRequest m_request;
+    ProtoResponse m_response;
+    bool m_valid;
+};
+
+static bool setNonBlocking(int fd){
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// watches for input while the client may send and its output is not piling
+// up, and for writability while there is output left
+static void updateEvents(int epfd, Connection* conn){
+    size_t unsent = conn->m_out.size() - conn->m_sent;
+    unsigned int events = 0;
+    if (!conn->m_eof && unsent < OUTPUT_LIMIT) {
+        events |= EPOLLIN;
+    }
+    if (unsent > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events != conn->m_events) {
+        epoll_event event;
+        event.events = events;
+        event.data.ptr = conn;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, conn->m_fd, &event);
+        conn->m_events = events;
+    }
+}
+
+static void flushOutput(Connection* conn){
+    while (conn->m_sent < conn->m_out.size()) {
+        ssize_t written = send(conn->m_fd, conn->m_out.data() + conn->m_sent, conn->m_out.size() - conn->m_sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                conn->m_failed = true;
+            }
+            if (errno != EINTR) {
+                return;
+            }
+            continue;
+        }
+        conn->m_sent += (size_t)written;
+    }
+    conn->m_out.clear();
+    conn->m_sent = 0;
+}
+
+// appends the complete frames the client has sent to the batch
+static void readFrames(Connection* conn, vector<Pending>& batch){
+    unsigned char buffer[READ_LIMIT];
+    ssize_t received = recv(conn->m_fd, buffer, sizeof(buffer), 0);
+    if (received == 0) {
+        conn->m_eof = true;
+        return;
+    }
+    if (received < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            conn->m_failed = true;
+        }
+        return;
+    }
+    conn->m_in.insert(conn->m_in.end(), buffer, buffer + received);
+    size_t frames = conn->m_in.size() / PROTO_FRAME;
+    for (size_t i = 0; i < frames; i++) {
+        Pending pending;
+        pending.m_conn = conn;
+        pending.m_valid = pending.m_request.decode(conn->m_in.data() + i * PROTO_FRAME);
+        pending.m_response = ProtoResponse(S_BADREQUEST);
+        batch.push_back(pending);
+    }
+    conn->m_in.erase(conn->m_in.begin(), conn->m_in.begin() + frames * PROTO_FRAME);
+}
+
+// serves batch[first, last), which all have the same valid op
+static void serveRun(SatNet& network, SatNet::Cursor& cursor, vector<Pending>& batch, size_t first, size_t last){
+    PROTOOP op = batch[first].m_request.m_op;
+    if (op == P_COUNT) {
+        // a run of counts shares one traversal per inclination
+        int counts[4] = {-1, -1, -1, -1};
+        for (size_t i = first; i < last; i++) {
+            unsigned char inclin = batch[i].m_request.m_args;
+            if (inclin <= I97) {
+                if (counts[inclin] < 0) {
+                    counts[inclin] = network.countSatellites(static_cast<INCLIN>(inclin));
+                }
+                batch[i].m_response = ProtoResponse(S_OK, counts[inclin]);
+            }
+        }
+        return;
+    }
+
+    vector<Pending*> run;
+    for (size_t i = first; i < last; i++) {
+        run.push_back(&batch[i]);
+    }
+    std::stable_sort(run.begin(), run.end(),
+        [](const Pending* a, const Pending* b) {return a->m_request.m_id < b->m_request.m_id;});
+
+    for (size_t i = 0; i < run.size(); i++) {
+        const ProtoRequest& request = run[i]->m_request;
+        ProtoResponse& response = run[i]->m_response;
+        int id = request.m_id;
+        switch (op) {
+            case P_FIND:
+                response = cursor.seek(id) ? ProtoResponse(S_OK, 1) : ProtoResponse(S_NOTFOUND, 0);
+                break;
+            case P_SETSTATE:
+                if (request.m_args <= DECAYING) {
+                    if (cursor.seek(id)) {
+                        network.setState(cursor.get(), static_cast<STATE>(request.m_args));
+                        response = ProtoResponse(S_OK, 1);
+                    } else {
+                        response = ProtoResponse(S_NOTFOUND, 0);
+                    }
+                }
+                break;
+            case P_INSERT:
+                if (id >= MINID && id <= MAXID && (request.m_args >> 4) <= DECAYING) {
+                    Sat satellite(id, static_cast<ALT>(request.m_args & 3), static_cast<INCLIN>((request.m_args >> 2) & 3),
+                                  static_cast<STATE>(request.m_args >> 4));
+                    response = cursor.insertAfter(satellite) ? ProtoResponse(S_OK, 1) : ProtoResponse(S_EXISTS, 0);
+                }
+                break;
+            case P_REMOVE:
+                if (cursor.seek(id)) {
+                    cursor.remove();
+                    response = ProtoResponse(S_OK, 1);
+                } else {
+                    response = ProtoResponse(S_NOTFOUND, 0);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void serveBatch(SatNet& network, SatNet::Cursor& cursor, vector<Pending>& batch){
+    size_t first = 0;
+    while (first < batch.size()) {
+        if (!batch[first].m_valid) {
+            first++;    // already answered with S_BADREQUEST
+            continue;
+        }
+        size_t last = first + 1;
+        while (last < batch.size() && batch[last].m_valid && batch[last].m_request.m_op == batch[first].m_request.m_op) {
+            last++;
+        }
+        serveRun(network, cursor, batch, first, last);
+        first = last;
+    }
+}
+
+static void closeConnection(int epfd, Connection* conn, vector<Connection*>& connections){
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->m_fd, nullptr);
+    close(conn->m_fd);
+    connections.erase(std::find(connections.begin(), connections.end(), conn));
+    delete conn;
+}
+
+int main(int argc, char* argv[]){
+    if (argc < 2) {
+        cout << "usage: " << argv[0] << " <socket path> [--fill]" << endl;
+        return 1;
+    }
+    const char* path = argv[1];
+    bool fill = (argc > 2 && strcmp(argv[2], "--fill") == 0);
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        cout << "socket path too long: " << path << endl;
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) < 0
+        || listen(listener, SOMAXCONN) < 0 || !setNonBlocking(listener)) {
+        perror("satnetd: cannot listen");
+        return 1;
+    }
+    int epfd = epoll_create1(0);
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;   // the listener
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &event);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    SatNet network;
+    if (fill) {
+        vector<Sat> satellites;
+        for (int id = MINID; id <= MAXID; id++) {
+            satellites.push_back(Sat(id, static_cast<ALT>(id % 4), static_cast<INCLIN>(id % 4)));
+        }
+        network.buildFromSorted(satellites);
+    }
+    SatNet::Cursor cursor(network);
+    cout << "satnetd serving " << (fill ? MAXID - MINID + 1 : 0) << " satellites on " << path << endl;
+
+    vector<Connection*> connections;
+    vector<Pending> batch;
+    epoll_event events[MAX_EVENTS];
+    long long requests = 0;
+    long long batches = 0;
+    while (!g_stop) {
+        int ready = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("satnetd: epoll_wait");
+            break;
+        }
+
+        batch.clear();
+        vector<Connection*> touched;
+        for (int i = 0; i < ready; i++) {
+            Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+            if (conn == nullptr) {
+                int fd;
+                while ((fd = accept(listener, nullptr, nullptr)) >= 0) {
+                    setNonBlocking(fd);
+                    conn = new Connection();
+                    conn->m_fd = fd;
+                    conn->m_events = EPOLLIN;
+                    epoll_event added;
+                    added.events = EPOLLIN;
+                    added.data.ptr = conn;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &added);
+                    connections.push_back(conn);
+                }
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                flushOutput(conn);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                readFrames(conn, batch);
+            }
+            touched.push_back(conn);
+        }
+
+        if (!batch.empty()) {
+            serveBatch(network, cursor, batch);
+            requests += (long long)batch.size();
+            batches++;
+            unsigned char frame[PROTO_FRAME];
+            for (size_t i = 0; i < batch.size(); i++) {
+                batch[i].m_response.encode(frame);
+                batch[i].m_conn->m_out.insert(batch[i].m_conn->m_out.end(), frame, frame + PROTO_FRAME);
+            }
+        }
+
+        for (size_t i = 0; i < touched.size(); i++) {
+            Connection* conn = touched[i];
+            flushOutput(conn);
+            if (conn->m_failed || (conn->m_eof && conn->m_out.empty())) {
+                closeConnection(epfd, conn, connections);
+            } else {
+                updateEvents(epfd, conn);
+            }
+        }
+    }
+
+    while (!connections.empty()) {
+        closeConnection(epfd, connections.back(), connections);
+    }
+    close(epfd);
+    close(listener);
+    unlink(path);
+    cout << "satnetd served " << requests << " requests in " << batches << " batches ("
+         << (batches > 0 ? (double)requests / batches : 0.0) << " per batch)" << endl;
+    return 0;
+}
@@ -0,0 +1,78 @@
+//
+// Wire protocol between satnetd and its clients.
+// Both directions use fixed 8 byte little-endian frames, so a reader can
+// cut a stream into frames without any length prefix and a client can
+// keep many requests in flight on one connection. Responses come back
+// in request order per connection.
+//
+// request:  op byte, args byte, 2 reserved bytes, int32 id
+// response: status byte, 3 reserved bytes, int32 value
+//
+
+#ifndef SATPROTO_H
+#define SATPROTO_H
+#include <cstdint>
+
+#define PROTO_FRAME 8
+
+// args: setState the STATE, insert alt | inclin << 2 | state << 4 as in
+// satrace.h, count the INCLIN; value is 1 or 0 for hits, the count for P_COUNT
+enum PROTOOP {P_FIND, P_SETSTATE, P_INSERT, P_REMOVE, P_COUNT};
+#define PROTO_OPS 5
+enum PROTOSTATUS {S_OK, S_NOTFOUND, S_EXISTS, S_BADREQUEST};
+
+class ProtoRequest{
+public:
+    ProtoRequest(PROTOOP op = P_FIND, int id = 0, unsigned char args = 0)
+            :m_op(op), m_args(args), m_id(id){}
+    PROTOOP m_op;
+    unsigned char m_args;
+    int m_id;
+
+    void encode(unsigned char* frame) const{
+        frame[0] = (unsigned char)m_op;
+        frame[1] = m_args;
+        frame[2] = frame[3] = 0;
+        putInt(frame + 4, m_id);
+    }
+    // false for an op this version does not know
+    bool decode(const unsigned char* frame){
+        if (frame[0] >= PROTO_OPS) {
+            return false;
+        }
+        m_op = static_cast<PROTOOP>(frame[0]);
+        m_args = frame[1];
+        m_id = getInt(frame + 4);
+        return true;
+    }
+
+    static void putInt(unsigned char* out, int value){
+        uint32_t bits = (uint32_t)value;
+        out[0] = (unsigned char)bits;
+        out[1] = (unsigned char)(bits >> 8);
+        out[2] = (unsigned char)(bits >> 16);
+        out[3] = (unsigned char)(bits >> 24);
+    }
+    static int getInt(const unsigned char* in){
+        return (int)((uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24);
+    }
+};
+
+class ProtoResponse{
+public:
+    ProtoResponse(PROTOSTATUS status = S_OK, int value = 0)
+            :m_status(status), m_value(value){}
+    PROTOSTATUS m_status;
+    int m_value;
+
+    void encode(unsigned char* frame) const{
+        frame[0] = (unsigned char)m_status;
+        frame[1] = frame[2] = frame[3] = 0;
+        ProtoRequest::putInt(frame + 4, m_value);
+    }
+    void decode(const unsigned char* frame){
+        m_status = static_cast<PROTOSTATUS>(frame[0]);
+        m_value = ProtoRequest::getInt(frame + 4);
+    }
+};
+#endif
@@ -0,0 +1,189 @@
+//
+// Workload traces for SatNet.
+//
+
+#include "satrace.h"
+#include <algorithm>
+#include <thread>
+
+static const char TRACE_MAGIC[8] = {'S', 'A', 'T', 'T', 'R', 'C', '1', '\n'};
+#define TRACE_BUFFER 65536
+
+TraceRecorder::TraceRecorder(){
+    m_lastID = 0;
+    m_lastTime = 0;
+    m_records = 0;
+}
+
+TraceRecorder::~TraceRecorder(){
+    close();
+}
+
+bool TraceRecorder::open(const string& path){
+    close();
+    m_file.open(path, ios::binary | ios::trunc);
+    if (!m_file.is_open()) {
+        return false;
+    }
+    m_file.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    m_start = std::chrono::steady_clock::now();
+    m_lastID = 0;
+    m_lastTime = 0;
+    m_records = 0;
+    return true;
+}
+
+void TraceRecorder::close(){
+    if (m_file.is_open()) {
+        flush();
+        m_file.close();
+    }
+}
+
+void TraceRecorder::putVarint(unsigned long long value){
+    while (value >= 0x80) {
+        m_buffer.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    m_buffer.push_back((unsigned char)value);
+}
+
+void TraceRecorder::flush(){
+    m_file.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size());
+    m_buffer.clear();
+}
+
+void TraceRecorder::record(TRACEOP op, int id, unsigned char args){
+    if (!m_file.is_open()) {
+        return;
+    }
+    long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+    long long idDelta = (long long)id - m_lastID;
+    m_buffer.push_back((unsigned char)op);
+    m_buffer.push_back(args);
+    putVarint(((unsigned long long)idDelta << 1) ^ (unsigned long long)(idDelta >> 63)); // zigzag
+    putVarint((unsigned long long)(now - m_lastTime));
+    m_lastID = id;
+    m_lastTime = now;
+    m_records++;
+    if (m_buffer.size() >= TRACE_BUFFER) {
+        flush();
+    }
+}
+
+static bool getVarint(const vector<unsigned char>& data, size_t& pos, unsigned long long& value){
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        unsigned char byte = data[pos++];
+        value |= (unsigned long long)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceReplayer::load(const string& path, vector<TraceRecord>& records){
+    std::ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(TRACE_MAGIC) || !std::equal(TRACE_MAGIC, TRACE_MAGIC + sizeof(TRACE_MAGIC), data.begin())) {
+        return false;
+    }
+
+    size_t pos = sizeof(TRACE_MAGIC);
+    long long id = 0;
+    long long time = 0;
+    while (pos < data.size()) {
+        if (pos + 2 > data.size() || data[pos] >= TRACE_OPS) {
+            return false;
+        }
+        TRACEOP op = static_cast<TRACEOP>(data[pos]);
+        unsigned char args = data[pos + 1];
+        pos += 2;
+        unsigned long long zigzag = 0;
+        unsigned long long timeDelta = 0;
+        if (!getVarint(data, pos, zigzag) || !getVarint(data, pos, timeDelta)) {
+            return false;   // truncated record
+        }
+        id += (long long)(zigzag >> 1) ^ -(long long)(zigzag & 1);
+        time += (long long)timeDelta;
+        records.push_back(TraceRecord(op, (int)id, args, time));
+    }
+    return true;
+}
+
+double ReplayStats::percentile(double p) const{
+    if (m_latency.empty()) {
+        return 0;
+    }
+    size_t index = (size_t)(p / 100.0 * (m_latency.size() - 1));
+    return m_latency[index];
+}
+
+ReplayStats TraceReplayer::replay(const vector<TraceRecord>& records, SatNet& network, bool paced){
+    ReplayStats stats;
+    stats.m_latency.reserve(records.size());
+    long long sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long long firstTime = records.empty() ? 0 : records[0].m_time;
+
+    vector<Sat> snapshot;
+    for (size_t i = 0; i < records.size(); i++) {
+        const TraceRecord& record = records[i];
+        if (paced) {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.m_time - firstTime));
+        }
+        if (record.m_op == T_SNAPSHOT) {
+            // the run is the tree in preorder, so a node's left child is the
+            // next record when its ID is smaller, and ranks add up from the back
+            size_t end = i;
+            while (end < records.size() && records[end].m_op == T_SNAPSHOT) {
+                end++;
+            }
+            snapshot.clear();
+            for (size_t k = i; k < end; k++) {
+                snapshot.push_back(Sat(records[k].m_id, static_cast<ALT>(records[k].m_args & 3),
+                                       static_cast<INCLIN>((records[k].m_args >> 2) & 3),
+                                       static_cast<STATE>((records[k].m_args >> 4) & 3)));
+            }
+            for (size_t k = end; k-- > i; ) {
+                bool hasLeft = k + 1 < end && records[k + 1].m_id < records[k].m_id;
+                snapshot[k - i].setHeight((hasLeft ? snapshot[k + 1 - i].getHeight() : 0) + (records[k].m_args >> 6));
+            }
+            std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+            network.restoreSnapshot(snapshot);
+            stats.m_latency.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - before).count());
+            stats.m_opCount[T_SNAPSHOT]++;
+            i = end - 1;
+            continue;
+        }
+        std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+        switch (record.m_op) {
+            case T_INSERT:
+                network.insert(Sat(record.m_id, static_cast<ALT>(record.m_args & 3),
+                                   static_cast<INCLIN>((record.m_args >> 2) & 3), static_cast<STATE>((record.m_args >> 4) & 3)));
+                break;
+            case T_REMOVE: network.remove(record.m_id); break;
+            case T_SETSTATE: sink += network.setState(record.m_id, static_cast<STATE>(record.m_args & 3)); break;
+            case T_FIND: sink += network.findSatellite(record.m_id); break;
+            case T_COUNT: sink += network.countSatellites(static_cast<INCLIN>(record.m_args & 3)); break;
+            case T_LIST: sink += network.collectSatellites([](const Sat&) {return true;}).size(); break;
+            case T_REMOVEDEORBITED: network.removeDeorbited(); break;
+            case T_CLEAR: network.clear(); break;
+            case T_SNAPSHOT: break;
+        }
+        stats.m_latency.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - before).count());
+        stats.m_opCount[record.m_op]++;
+    }
+
+    stats.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.m_ops = (long long)stats.m_latency.size();
+    std::sort(stats.m_latency.begin(), stats.m_latency.end());
+    if (sink < 0) {
+        cout << sink;   // keeps the lookups from being optimized away
+    }
+    return stats;
+}
@@ -0,0 +1,77 @@
+//
+// Workload traces for SatNet.
+// A TraceRecorder attached to a SatNet writes every public call to a
+// compact binary file; the replayer runs such a trace against a fresh
+// SatNet, at full speed or at the recorded pace, and measures each call.
+//
+// File layout: the 8 byte magic "SATTRC1\n" followed by records of
+//   op byte, args byte, zigzag varint ID delta, varint nanosecond delta
+// where the deltas are taken from the previous record.
+// operator= and buildFromSorted are traced as a clear followed by one
+// snapshot record per node in preorder, which the replayer rebuilds into
+// the same tree in a single call; tombstones copied along are removed
+// again by remove records after the snapshot.
+//
+
+#ifndef SATRACE_H
+#define SATRACE_H
+#include "satnet.h"
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum TRACEOP {T_INSERT, T_REMOVE, T_SETSTATE, T_FIND, T_COUNT, T_LIST, T_REMOVEDEORBITED, T_CLEAR, T_SNAPSHOT};
+#define TRACE_OPS 9
+
+class TraceRecord{
+public:
+    TraceRecord(TRACEOP op = T_FIND, int id = 0, unsigned char args = 0, long long time = 0)
+            :m_op(op), m_id(id), m_args(args), m_time(time){}
+    TRACEOP m_op;
+    int m_id;
+    // insert: alt | inclin << 2 | state << 4, setState: state, count: inclin,
+    // snapshot: as insert plus the node's rank minus its left child's << 6
+    unsigned char m_args;
+    long long m_time;       // nanoseconds since the recorder started
+};
+
+class TraceRecorder{
+public:
+    TraceRecorder();
+    ~TraceRecorder();
+    bool open(const string& path);
+    void close();
+    bool isOpen() const {return m_file.is_open();}
+    void record(TRACEOP op, int id = 0, unsigned char args = 0);
+    long long getRecords() const {return m_records;}
+private:
+    std::ofstream m_file;
+    vector<unsigned char> m_buffer;
+    std::chrono::steady_clock::time_point m_start;
+    int m_lastID;
+    long long m_lastTime;
+    long long m_records;
+
+    void putVarint(unsigned long long value);
+    void flush();
+};
+
+class ReplayStats{
+public:
+    long long m_ops = 0;            // calls, a snapshot counts once
+    double m_seconds = 0;           // wall time of the whole replay
+    vector<double> m_latency;       // microseconds per call, sorted
+    long long m_opCount[TRACE_OPS] = {0};
+    double percentile(double p) const;
+};
+
+class TraceReplayer{
+public:
+    static bool load(const string& path, vector<TraceRecord>& records);
+    // runs the records against network; paced waits for each recorded timestamp.
+    // T_LIST is replayed as a full collection so no output is printed, and a
+    // run of T_SNAPSHOT records as one restore of the whole tree
+    static ReplayStats replay(const vector<TraceRecord>& records, SatNet& network, bool paced = false);
+};
+#endif
@@ -0,0 +1,37 @@
+//
+// Replays a SatNet workload trace and reports throughput and latency.
+// usage: satreplay <trace file> [--paced]
+//
+
+#include "satrace.h"
+#include <cstring>
+
+int main(int argc, char* argv[]){
+    if (argc < 2) {
+        cout << "usage: " << argv[0] << " <trace file> [--paced]" << endl;
+        return 1;
+    }
+    bool paced = (argc > 2 && strcmp(argv[2], "--paced") == 0);
+
+    vector<TraceRecord> records;
+    if (!TraceReplayer::load(argv[1], records)) {
+        cout << "cannot read trace " << argv[1] << endl;
+        return 1;
+    }
+
+    SatNet network;
+    ReplayStats stats = TraceReplayer::replay(records, network, paced);
+
+    const char* names[TRACE_OPS] = {"insert", "remove", "setState", "find", "count", "list", "removeDeorbited", "clear", "snapshot"};
+    cout << stats.m_ops << " calls in " << stats.m_seconds << " s (" << (paced ? "recorded pace" : "full speed") << ")" << endl;
+    cout << "throughput: " << stats.m_ops / stats.m_seconds << " calls/s" << endl;
+    cout << "latency us  p50: " << stats.percentile(50) << "  p90: " << stats.percentile(90)
+         << "  p99: " << stats.percentile(99) << "  p99.9: " << stats.percentile(99.9)
+         << "  max: " << stats.percentile(100) << endl;
+    for (int op = 0; op < TRACE_OPS; op++) {
+        if (stats.m_opCount[op] > 0) {
+            cout << "  " << names[op] << ": " << stats.m_opCount[op] << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+//
+// SatNet split by ID range into independent AVL shards.
+//
+
+#include "shardedsatnet.h"
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+ShardedSatNet::ShardedSatNet(int shards, TaskPool* pool){
+    m_count = (shards < 1) ? 1 : shards;
+    m_shards.reset(new Shard[m_count]);
+    m_span = (MAXID - MINID + 1 + m_count - 1) / m_count;
+    m_pool = pool;
+}
+
+int ShardedSatNet::shardOf(int id) const{
+    if (id < MINID) {
+        return 0;
+    }
+    int shard = (id - MINID) / m_span;
+    return (shard < m_count) ? shard : m_count - 1;
+}
+
+// runs work(index) for every shard, in parallel when there is a pool
+template <class Work>
+void ShardedSatNet::forEachShard(Work work) const{
+    TaskGroup group(m_pool);
+    for (int i = 0; i < m_count; i++) {
+        group.run([&work, i] {work(i);});
+    }
+    group.wait();
+}
+
+const ShardedSatNet & ShardedSatNet::operator=(const ShardedSatNet & rhs){
+    if (this == &rhs) {
+        return *this;
+    }
+    if (m_count != rhs.m_count) {
+        // the shards of rhs cover consecutive ID ranges, so reading them in
+        // order gives every satellite in ascending ID order
+        vector<Sat> satellites;
+        for (int i = 0; i < rhs.m_count; i++) {
+            std::lock_guard<std::mutex> lock(rhs.m_shards[i].m_mutex);
+            vector<const Sat*> shard = rhs.m_shards[i].m_network.collectSatellites([](const Sat&) {return true;});
+            for (size_t k = 0; k < shard.size(); k++) {
+                satellites.push_back(*shard[k]);
+            }
+        }
+        // each of our shards then takes one contiguous slice, cut where its range starts
+        vector<size_t> start(m_count + 1, 0);
+        for (int i = 1; i < m_count; i++) {
+            start[i] = lower_bound(satellites.begin() + start[i - 1], satellites.end(), MINID + i * m_span,
+                                   [](const Sat& satellite, int id) {return satellite.getID() < id;}) - satellites.begin();
+        }
+        start[m_count] = satellites.size();
+        forEachShard([this, &satellites, &start](int i) {
+            vector<Sat> mine(satellites.begin() + start[i], satellites.begin() + start[i + 1]);
+            std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+            m_shards[i].m_network.buildFromSorted(mine);
+        });
+        return *this;
+    }
+    forEachShard([this, &rhs](int i) {
+        std::lock(m_shards[i].m_mutex, rhs.m_shards[i].m_mutex);
+        std::lock_guard<std::mutex> mine(m_shards[i].m_mutex, std::adopt_lock);
+        std::lock_guard<std::mutex> theirs(rhs.m_shards[i].m_mutex, std::adopt_lock);
+        m_shards[i].m_network = rhs.m_shards[i].m_network;
+    });
+    return *this;
+}
+
+void ShardedSatNet::insert(const Sat& satellite){
+    Shard& shard = m_shards[shardOf(satellite.getID())];
+    std::lock_guard<std::mutex> lock(shard.m_mutex);
+    shard.m_network.insert(satellite);
+}
+
+void ShardedSatNet::remove(int id){
+    Shard& shard = m_shards[shardOf(id)];
+    std::lock_guard<std::mutex> lock(shard.m_mutex);
+    shard.m_network.remove(id);
+}
+
+bool ShardedSatNet::setState(int id, STATE state){
+    Shard& shard = m_shards[shardOf(id)];
+    std::lock_guard<std::mutex> lock(shard.m_mutex);
+    return shard.m_network.setState(id, state);
+}
+
+bool ShardedSatNet::findSatellite(int id) const{
+    const Shard& shard = m_shards[shardOf(id)];
+    std::lock_guard<std::mutex> lock(shard.m_mutex);
+    return shard.m_network.findSatellite(id);
+}
+
+void ShardedSatNet::clear(){
+    forEachShard([this](int i) {
+        std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+        m_shards[i].m_network.clear();
+    });
+}
+
+void ShardedSatNet::removeDeorbited(){
+    forEachShard([this](int i) {
+        std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+        m_shards[i].m_network.removeDeorbited();
+    });
+}
+
+int ShardedSatNet::countSatellites(INCLIN degree) const{
+    vector<int> counts(m_count, 0);
+    forEachShard([this, &counts, degree](int i) {
+        std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+        counts[i] = m_shards[i].m_network.countSatellites(degree);
+    });
+    int total = 0;
+    for (int i = 0; i < m_count; i++) {
+        total += counts[i];
+    }
+    return total;
+}
+
+void ShardedSatNet::listSatellites() const{
+    // each shard formats its own lines under its lock, shards are ID ranges
+    // so printing them in shard order lists the whole net in ID order
+    vector<string> lines(m_count);
+    forEachShard([this, &lines](int i) {
+        std::ostringstream out;
+        std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+        vector<const Sat*> satellites = m_shards[i].m_network.collectSatellites([](const Sat&) {return true;});
+        for (size_t j = 0; j < satellites.size(); j++) {
+            const Sat* node = satellites[j];
+            out << node->getID() << ": " << node->getStateStr() << ": " << node->getInclinStr() << ": " << node->getAltStr() << endl;
+        }
+        lines[i] = out.str();
+    });
+    for (int i = 0; i < m_count; i++) {
+        cout << lines[i];
+    }
+}
+
+void ShardedSatNet::dumpTree() const{
+    for (int i = 0; i < m_count; i++) {
+        std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+        cout << "shard " << i << ": ";
+        m_shards[i].m_network.dumpTree();
+        cout << endl;
+    }
+}
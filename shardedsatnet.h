@@ -0,0 +1,52 @@
+//
+// SatNet split by ID range into independent AVL shards.
+// Every shard has its own lock, so point operations on different shards
+// run in parallel; whole-constellation operations scatter over the shards
+// on a task pool and gather the results in ID order.
+//
+
+#ifndef SHARDEDSATNET_H
+#define SHARDEDSATNET_H
+#include "satnet.h"
+#include <memory>
+#include <mutex>
+
+#define DEFAULT_SHARDS 16
+
+class ShardedSatNet{
+public:
+    friend class Tester;
+    // MINID..MAXID is cut into equal ranges, IDs outside it go to the first
+    // or last shard; without a pool the shards are visited one after another
+    explicit ShardedSatNet(int shards = DEFAULT_SHARDS, TaskPool* pool = nullptr);
+    ShardedSatNet(const ShardedSatNet & rhs) = delete;
+    // copies the satellites of rhs, routed into this object's own shards
+    // when the shard counts differ
+    const ShardedSatNet & operator=(const ShardedSatNet & rhs);
+    void insert(const Sat& satellite);
+    void clear();
+    void remove(int id);
+    void dumpTree() const;
+    void listSatellites() const;
+    bool setState(int id, STATE state);
+    void removeDeorbited();
+    bool findSatellite(int id) const;
+    int countSatellites(INCLIN degree) const;
+    int getShards() const {return m_count;}
+
+private:
+    class alignas(64) Shard{
+    public:
+        mutable std::mutex m_mutex;
+        SatNet m_network;
+    };
+    std::unique_ptr<Shard[]> m_shards;
+    int m_count;
+    int m_span;         // IDs per shard
+    TaskPool* m_pool;   // not owned
+
+    int shardOf(int id) const;
+    template <class Work>
+    void forEachShard(Work work) const;
+};
+#endif
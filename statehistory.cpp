@@ -0,0 +1,163 @@
+//
+// Append-only history of satellite state transitions.
+//
+
+#include "statehistory.h"
+#include <algorithm>
+
+StateHistory::StateHistory(){
+    m_transitions = 0;
+}
+
+void StateHistory::clear(){
+    m_tracks.clear();
+    m_transitions = 0;
+}
+
+void StateHistory::append(int id, long long time, STATE state){
+    Track& track = m_tracks[id];
+    if (track.m_count > 0 && time < track.m_last) {
+        time = track.m_last;
+    }
+    bool chunkStart = (track.m_count % HISTORY_CHUNK == 0);
+    if (chunkStart) {
+        if (track.m_chunks.size() == track.m_chunks.capacity()) {
+            track.m_chunks.reserve(track.m_chunks.size() + track.m_chunks.size() / 4 + 1);
+        }
+        Chunk chunk;
+        chunk.m_first = time;
+        chunk.m_offset = (unsigned int)track.m_data.size();
+        track.m_chunks.push_back(chunk);
+    }
+    // grow by a quarter instead of doubling, slack would cost more than the encoding
+    if (track.m_data.capacity() - track.m_data.size() < 11) {
+        track.m_data.reserve(track.m_data.size() + track.m_data.size() / 4 + 16);
+    }
+    if (track.m_count % 4 == 0) {
+        track.m_stateByte = (unsigned int)track.m_data.size();
+        track.m_data.push_back(0);
+    }
+    track.m_data[track.m_stateByte] |= (unsigned char)(state << ((track.m_count % 4) * 2));
+
+    // the first transition of a chunk takes its time from the chunk index
+    if (!chunkStart) {
+        unsigned long long delta = (unsigned long long)(time - track.m_last);
+        while (delta >= 0x80) {
+            track.m_data.push_back((unsigned char)(delta | 0x80));
+            delta >>= 7;
+        }
+        track.m_data.push_back((unsigned char)delta);
+    }
+    track.m_last = time;
+    track.m_count++;
+    m_transitions++;
+}
+
+// the last chunk starting before time, or the first one
+int StateHistory::findChunk(const Track& track, long long time) const{
+    // chunks starting exactly at time may follow transitions at the same time
+    vector<Chunk>::const_iterator it = lower_bound(track.m_chunks.begin(), track.m_chunks.end(), time,
+        [](const Chunk& chunk, long long t) {return chunk.m_first < t;});
+    return (it == track.m_chunks.begin()) ? 0 : (int)(it - track.m_chunks.begin()) - 1;
+}
+
+// decodes the track from the given chunk on, calling visit(time, state)
+// until it returns false or the track ends
+template <class Visit>
+void StateHistory::scan(const Track& track, int chunk, Visit visit) const{
+    const unsigned char* data = track.m_data.data();
+    size_t pos = track.m_chunks[chunk].m_offset;
+    long long time = 0;
+    unsigned char states = 0;
+    for (int i = chunk * HISTORY_CHUNK; i < track.m_count; i++) {
+        if (i % 4 == 0) {
+            states = data[pos++];
+        }
+        if (i % HISTORY_CHUNK == 0) {
+            time = track.m_chunks[i / HISTORY_CHUNK].m_first;
+        } else {
+            unsigned long long delta = 0;
+            for (int shift = 0; ; shift += 7) {
+                unsigned char byte = data[pos++];
+                delta |= (unsigned long long)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    break;
+                }
+            }
+            time += (long long)delta;
+        }
+        if (!visit(time, static_cast<STATE>((states >> ((i % 4) * 2)) & 3))) {
+            return;
+        }
+    }
+}
+
+bool StateHistory::stateAt(int id, long long time, STATE& state) const{
+    unordered_map<int, Track>::const_iterator it = m_tracks.find(id);
+    if (it == m_tracks.end() || it->second.m_chunks.empty() || it->second.m_chunks[0].m_first > time) {
+        return false;
+    }
+    // the first chunk starting after time bounds the search
+    const Track& track = it->second;
+    vector<Chunk>::const_iterator after = upper_bound(track.m_chunks.begin(), track.m_chunks.end(), time,
+        [](long long t, const Chunk& chunk) {return t < chunk.m_first;});
+    scan(track, (int)(after - track.m_chunks.begin()) - 1, [time, &state](long long at, STATE entered) {
+        if (at > time) {
+            return false;
+        }
+        state = entered;
+        return true;
+    });
+    return true;
+}
+
+vector<pair<long long, STATE>> StateHistory::transitions(int id, long long from, long long to) const{
+    vector<pair<long long, STATE>> result;
+    unordered_map<int, Track>::const_iterator it = m_tracks.find(id);
+    if (it == m_tracks.end() || it->second.m_count == 0) {
+        return result;
+    }
+    scan(it->second, findChunk(it->second, from), [from, to, &result](long long at, STATE entered) {
+        if (at > to) {
+            return false;
+        }
+        if (at >= from) {
+            result.push_back(make_pair(at, entered));
+        }
+        return true;
+    });
+    return result;
+}
+
+int StateHistory::countInState(STATE state, long long from, long long to) const{
+    int count = 0;
+    for (unordered_map<int, Track>::const_iterator it = m_tracks.begin(); it != m_tracks.end(); ++it) {
+        const Track& track = it->second;
+        if (track.m_count == 0 || track.m_chunks[0].m_first > to) {
+            continue;
+        }
+        // the state held when the window opens counts, and so does any entered inside it
+        bool found = false;
+        scan(track, findChunk(track, from), [state, from, to, &found](long long at, STATE entered) {
+            if (at > to) {
+                return false;
+            }
+            if (at <= from) {
+                found = (entered == state);
+                return true;
+            }
+            found = found || entered == state;
+            return !found;
+        });
+        count += found;
+    }
+    return count;
+}
+
+size_t StateHistory::getBytes() const{
+    size_t bytes = 0;
+    for (unordered_map<int, Track>::const_iterator it = m_tracks.begin(); it != m_tracks.end(); ++it) {
+        bytes += sizeof(Track) + it->second.m_data.capacity() + it->second.m_chunks.capacity() * sizeof(Chunk);
+    }
+    return bytes;
+}
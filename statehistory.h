@@ -0,0 +1,58 @@
+//
+// Append-only history of satellite state transitions.
+// Each satellite has its own byte stream, so a query only decodes the
+// satellite it asks about. Transitions are stored in groups of four: one
+// byte with four 2-bit states followed by four varint time deltas, where
+// each delta is taken from the previous transition. Every HISTORY_CHUNK
+// transitions a chunk starts, and a small per-satellite index of chunk
+// start times lets point queries skip straight to the right chunk.
+//
+
+#ifndef STATEHISTORY_H
+#define STATEHISTORY_H
+#include "satnet.h"
+#include <unordered_map>
+#include <vector>
+
+#define HISTORY_CHUNK 64    // transitions per indexed chunk, a multiple of 4
+
+class StateHistory{
+public:
+    friend class Tester;
+    StateHistory();
+    // records that the satellite entered state at time; a time before the
+    // satellite's last transition is recorded at that last time
+    void append(int id, long long time, STATE state);
+    // the state the satellite was in at time, false if it had no transition yet
+    bool stateAt(int id, long long time, STATE& state) const;
+    // transitions of the satellite with from <= time <= to, in time order
+    vector<pair<long long, STATE>> transitions(int id, long long from, long long to) const;
+    // satellites that were in state at some moment of from..to
+    int countInState(STATE state, long long from, long long to) const;
+    long long getTransitions() const {return m_transitions;}
+    int getSatellites() const {return (int)m_tracks.size();}
+    size_t getBytes() const;    // encoded streams and chunk indexes
+    void clear();
+
+private:
+    class Chunk{
+    public:
+        long long m_first;      // time of the first transition in the chunk
+        unsigned int m_offset;  // where the chunk starts in the stream
+    };
+    class Track{
+    public:
+        vector<unsigned char> m_data;
+        vector<Chunk> m_chunks;
+        long long m_last = 0;       // time of the latest transition
+        int m_count = 0;
+        unsigned int m_stateByte = 0;   // offset of the state byte of the open group
+    };
+    unordered_map<int, Track> m_tracks;
+    long long m_transitions;
+
+    int findChunk(const Track& track, long long time) const;
+    template <class Visit>
+    void scan(const Track& track, int chunk, Visit visit) const;
+};
+#endif
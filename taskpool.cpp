@@ -0,0 +1,126 @@
+//
+// Small fork-join thread pool used to split tree work by subtree.
+//
+
+#include "taskpool.h"
+
+// which pool and queue the current thread works for
+static thread_local const TaskPool* t_pool = nullptr;
+static thread_local int t_queue = -1;
+
+TaskPool::TaskPool(int threads){
+    m_threads = (threads < 1) ? 1 : threads;
+    m_stop = false;
+    m_queued = 0;
+    m_steals = 0;
+    for (int i = 0; i < m_threads; i++) {
+        m_queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    // queue 0 belongs to outside threads, workers use 1..threads-1
+    for (int i = 1; i < m_threads; i++) {
+        m_workers.push_back(std::thread(&TaskPool::workerLoop, this, i));
+    }
+}
+
+TaskPool::~TaskPool(){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_ready.notify_all();
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        m_workers[i].join();
+    }
+}
+
+int TaskPool::ownQueue() const{
+    return (t_pool == this) ? t_queue : 0;
+}
+
+void TaskPool::submit(std::function<void()> task){
+    WorkQueue& queue = *m_queues[ownQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.m_mutex);
+        queue.m_tasks.push_back(std::move(task));
+    }
+    m_queued++;
+    {
+        // pairs with the predicate check in workerLoop so no wakeup is lost
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_ready.notify_one();
+}
+
+bool TaskPool::takeTask(int self, std::function<void()>& task){
+    {
+        // newest own task first, it is the smallest and still cache warm
+        WorkQueue& queue = *m_queues[self];
+        std::lock_guard<std::mutex> lock(queue.m_mutex);
+        if (!queue.m_tasks.empty()) {
+            task = std::move(queue.m_tasks.back());
+            queue.m_tasks.pop_back();
+            m_queued--;
+            return true;
+        }
+    }
+    for (int i = 1; i < m_threads; i++) {
+        // steal the oldest task of a victim, it is the largest subtree
+        WorkQueue& victim = *m_queues[(self + i) % m_threads];
+        std::lock_guard<std::mutex> lock(victim.m_mutex);
+        if (!victim.m_tasks.empty()) {
+            task = std::move(victim.m_tasks.front());
+            victim.m_tasks.pop_front();
+            m_queued--;
+            m_steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskPool::runPending(){
+    std::function<void()> task;
+    if (!takeTask(ownQueue(), task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void TaskPool::workerLoop(int index){
+    t_pool = this;
+    t_queue = index;
+    while (true) {
+        std::function<void()> task;
+        if (takeTask(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready.wait(lock, [this] {return m_stop || m_queued.load() > 0;});
+        if (m_stop && m_queued.load() == 0) {
+            return; // stopping and nothing left to do
+        }
+    }
+}
+
+void TaskGroup::run(std::function<void()> task){
+    if (m_pool == nullptr || m_pool->getThreads() == 1) {
+        task();
+        return;
+    }
+    m_pending++;
+    m_pool->submit([this, task] {
+        task();
+        m_pending--;
+    });
+}
+
+void TaskGroup::wait(){
+    while (m_pending.load() > 0) {
+        // help instead of blocking so nested fork-join cannot deadlock
+        if (!m_pool->runPending()) {
+            std::this_thread::yield();
+        }
+    }
+}
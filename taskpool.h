@@ -0,0 +1,61 @@
+//
+// Small fork-join thread pool used to split tree work by subtree.
+// Every worker owns a deque: it pushes and pops forked tasks at the back
+// and idle workers steal the oldest (largest) tasks from the front.
+//
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskPool{
+public:
+    // threads counts the calling thread, which helps while it waits,
+    // so a pool of 1 thread runs everything inline
+    explicit TaskPool(int threads = std::thread::hardware_concurrency());
+    ~TaskPool();
+    int getThreads() const {return m_threads;}
+    long getSteals() const {return m_steals.load();}
+    void submit(std::function<void()> task);
+    bool runPending();  // runs one queued task on the calling thread, false if none
+private:
+    class WorkQueue{
+    public:
+        std::mutex m_mutex;
+        std::deque<std::function<void()>> m_tasks;
+    };
+
+    int m_threads;
+    bool m_stop;
+    std::vector<std::thread> m_workers;
+    // one queue per thread: 0 for threads outside the pool, 1..m_threads-1 for the workers
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::atomic<int> m_queued;      // tasks sitting in any queue
+    std::atomic<long> m_steals;     // tasks taken from another thread's queue
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+
+    int ownQueue() const;
+    bool takeTask(int self, std::function<void()>& task);
+    void workerLoop(int index);
+};
+
+// a set of forked tasks that can be joined as a unit
+class TaskGroup{
+public:
+    explicit TaskGroup(TaskPool* pool):m_pool(pool), m_pending(0){}
+    ~TaskGroup(){wait();}
+    void run(std::function<void()> task);
+    void wait();    // blocks until every task of the group has finished, running queued tasks meanwhile
+private:
+    TaskPool* m_pool;
+    std::atomic<int> m_pending;
+};
+#endif